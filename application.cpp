@@ -1,15 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <clocale>
 #include <string>
 #include <cstring>
 #include <map>
+#include <thread>
 #include <vector>
 #include <histedit.h>
-#include "util.h"
 #include "application.h"
+#include "batch_script.h"
 #include "console.h"
+#include "command_stats.h"
+#include "job_table.h"
 #include "token_parser.h"
 #include "wcs_util.h"
+#include "detail/argv_tokenizer.h"
+#include "detail/completion_runner.h"
+#include "detail/history_store.h"
+#include "detail/server.h"
+#include "detail/session.h"
+#include "detail/stats_timer.h"
 #include <cerrno>
+#include <cstdio>
+#include <cwchar>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -40,44 +55,159 @@ public:
     EditlineWrapper()
     : history_(nullptr)
     , editline_(nullptr)
+    , loaded_history_(nullptr)
+    , history_loaded_(false)
     {}
     HistoryW *history_;
     EditLine *editline_;
+
+    // The history file is loaded in the background, see Application::init().
+    std::thread history_loader_;
+    HistoryW *loaded_history_;
+    std::unique_ptr<detail::HistoryStore> loaded_store_;
+    std::atomic<bool> history_loaded_;
+
+    // All the commands ever entered, for searching. history_ has only the recent ones.
+    std::unique_ptr<detail::HistoryStore> store_;
 };
 
-// NOTE: function signature : el_func_t (declared in libedit/src/map.h)
-static el_action_t complete_handler(EditLine *editline, wint_t ch);
+static HistoryW *new_history()
+{
+    HistoryW *history = history_winit();
+    HistEventW event;
+    history_w(history, &event, H_SETSIZE, 1000); // remember 1000 events, the older ones are in HistoryStore
+    history_w(history, &event, H_SETUNIQUE, 1); // adjacent identical event strings should not be entered into the history
+    return history;
+}
+
 // NOTE: function signature : el_pfunc_t (declared in libedit/src/map.h)
 static wchar_t *prompt_handler(EditLine *editline);
+// NOTE: function signature : el_rfunc_t (declared in libedit/src/read.h)
+static int getc_handler(EditLine *editline, wchar_t *ch);
 
 Application::Application()
 : root_(new RootConsole())
-, prompt_(L"> ")
+, stats_(new CommandStats())
+, jobs_(new JobTable())
+, main_session_(new detail::Session())
+, session_(main_session_.get())
+, continuation_prompt_(L"... ")
+, completion_deadline_(0)
 , is_batch_mode_(false)
+, serving_(false)
+, job_notifications_(false)
 {
     el_.reset(new EditlineWrapper);
-    console_stack_.push_back(root_.get());
+    session_->console_stack.push_back(root_.get());
 }
 
 Application::~Application()
 {
+    jobs_.reset(); // stop the jobs before the commands are destroyed
+    completion_runner_.reset();
+    install_history(true); // save the commands entered while loading
     if (el_->editline_) {
         el_end(el_->editline_);
     }
     if (el_->history_) {
-        HistEventW event;
-        history_w(el_->history_, &event, H_SAVE, history_file_.c_str()); // save history
         history_wend(el_->history_);
     }
 }
 
+Output &Application::out()
+{
+    Output *output = Output::current();
+    return output ? *output : session_->output;
+}
+
+Console *Application::current_console() const
+{
+    return session_->console_stack.back();
+}
+
+CommandContext *Application::context()
+{
+    return session_->context.get();
+}
+
 CommandManager &Application::command_manager()
 {
     return root_->command_manager();
 }
 
+static const size_t MAX_SHOWN_CANDIDATES = 1000; // the rest are counted only
+static const size_t QUERY_CANDIDATES = 100; // ask before showing more candidates, like readline
+
+// Print the candidates in columns sorted downwards, like readline, fitting the width of the terminal.
+static void print_candidates(Output &out, const CompletionSink &sink)
+{
+    const std::vector<CompletionItem> &items = sink.items();
+    std::vector<std::string> texts;
+    std::vector<int> widths;
+    texts.reserve(items.size());
+    widths.reserve(items.size());
+    int max_width = 0;
+    for (const auto &item : items) {
+        const std::wstring &value = item.value();
+        int width = wcswidth(value.c_str(), value.size()); // e.g. 2 columns for a CJK character
+        if (width < 0) { // not printable
+            width = value.size();
+        }
+        max_width = std::max(max_width, width);
+        widths.push_back(width);
+        texts.push_back(wcs_to_mbs(value));
+    }
+
+    const int COLUMN_GAP = 2;
+    unsigned rows = 0;
+    unsigned cols = 0;
+    if (!Application::get_window_size(&rows, &cols) || cols == 0) {
+        cols = 80;
+    }
+    size_t num_columns = std::max<size_t>(1, (cols + COLUMN_GAP) / (max_width + COLUMN_GAP));
+    size_t num_rows = (items.size() + num_columns - 1) / num_columns;
+
+    // Write the whole block at once, rather than a candidate at a time.
+    std::string block(1, '\n');
+    block.reserve(num_rows * (cols + 1) + 64);
+    for (size_t row = 0; row < num_rows; row++) {
+        for (size_t i = row; i < items.size(); i += num_rows) {
+            block += texts[i];
+            if (i + num_rows < items.size()) { // not the last column
+                block.append(max_width + COLUMN_GAP - widths[i], ' ');
+            }
+        }
+        block += '\n';
+    }
+    if (sink.count() > items.size()) {
+        char more[64];
+        snprintf(more, sizeof(more), "%zu%s more...\n", sink.count() - items.size(), sink.stopped() ? "+" : "");
+        block += more;
+    }
+    out.write(Output::OUT, block);
+}
+
+// \return true if the user wants to see all the candidates.
+static bool confirm_candidates(Application &app, Output &out, size_t count)
+{
+    out.printf("\nDisplay all %zu possibilities? (y or n)", count);
+    out.flush();
+    wchar_t ch;
+    while (app.getc(&ch) == 1) {
+        switch (ch) {
+        case L'y': case L'Y': case L' ':
+            return true;
+        case L'n': case L'N': case 0x7f: case L'\a': case L'\r': case L'\n':
+            out.put(Output::OUT, '\n');
+            return false;
+        }
+    }
+    out.put(Output::OUT, '\n');
+    return false;
+}
+
 // for reference: https://github.com/seanchann/libcutil (libcutil/src/core/core.c, function cli_complete() )
-el_action_t complete_handler(EditLine *editline, wint_t /*ch*/)
+el_action_t Application::complete_handler(EditLine *editline, wint_t /*ch*/)
 {
     Application *self = nullptr;
     el_wget(editline, EL_CLIENTDATA, &self);
@@ -85,42 +215,46 @@ el_action_t complete_handler(EditLine *editline, wint_t /*ch*/)
     const LineInfoW *line_info = el_wline(editline);
 
     size_t buffer_len = line_info->lastchar - line_info->buffer;
-    std::wstring completion;
-    auto candidates = self->current_console()->auto_complete(*self, line_info->buffer, buffer_len, line_info->cursor, completion);
-    if (candidates.empty()) {
+    CompletionSink sink(MAX_SHOWN_CANDIDATES);
+    Console *console = self->current_console();
+    if (self->completion_deadline_ == 0) {
+        EXOLE_STATS_TIME(self->stats().entry(nullptr, console)->complete);
+        console->stream_complete(*self, line_info->buffer, buffer_len, line_info->cursor, sink);
+    }
+    else {
+        int ret = self->complete_in_background(line_info->buffer, buffer_len, line_info->cursor - line_info->buffer, sink);
+        if (ret < 0) { // cancelled by a key, which editline will read next
+            return CC_NORM;
+        }
+        if (ret == 0) { // the deadline has passed, show the candidates found so far
+            if (sink.count() == 0) {
+                return CC_ERROR;
+            }
+            Output &out = self->out();
+            print_candidates(out, sink);
+            out.printf("(incomplete, timed out after %u ms)\n", self->completion_deadline_);
+            out.flush();
+            return CC_REDISPLAY;
+        }
+    }
+    Output &out = self->out();
+    std::wstring completion = sink.completion();
+    if (sink.count() == 0) {
         return CC_ERROR;
     }
-    else if (candidates.size() == 1) {
-        if (candidates[0].is_complete()) {
+    else if (sink.count() == 1) {
+        if (sink.items()[0].is_complete()) {
             completion += L' ';
         }
         el_winsertstr(editline, completion.c_str());
         return CC_REDISPLAY;
     }
-    else if (candidates.size() > 1) {
+    else if (sink.count() > 1) {
         if (completion.empty()) { // cannot complete any more, just show candidates
-            printf("\n");
-            int line_length = 0;
-            for (auto candidate : candidates) {
-                const int MAX_LINE_LENGTH = 80;
-                const int TAB_WIDTH = 2;
-                // output spaces
-                if (line_length != 0) {
-                    int num_spaces = TAB_WIDTH - line_length % TAB_WIDTH;
-                    for (int i = 0; i < num_spaces; i++) {
-                        printf(" ");
-                    }
-                    line_length += num_spaces;
-                }
-                if (line_length + candidate.value().size() > MAX_LINE_LENGTH) {
-                    printf("\n");
-                    line_length = 0;
-                }
-
-                // print a candidate
-                line_length += printf("%ls", candidate.value().c_str());
+            if (sink.count() <= QUERY_CANDIDATES || confirm_candidates(*self, out, sink.count())) {
+                print_candidates(out, sink);
             }
-            printf("\n");
+            out.flush();
             return CC_REDISPLAY;
         }
         else {
@@ -131,6 +265,57 @@ el_action_t complete_handler(EditLine *editline, wint_t /*ch*/)
     return CC_NORM;
 }
 
+int Application::complete_in_background(const wchar_t *buffer, size_t len, size_t cursor, CompletionSink &sink)
+{
+    if (!completion_runner_) {
+        completion_runner_.reset(new detail::CompletionRunner);
+    }
+    std::wstring line(buffer, len); // the buffer may change while the request is running
+    Console *console = current_console();
+    completion_runner_->start([this, console, line, cursor](CompletionSink &request_sink) {
+        EXOLE_STATS_TIME(stats().entry(nullptr, console)->complete);
+        console->stream_complete(*this, line.c_str(), line.size(), line.c_str() + cursor, request_sink);
+    }, sink.limit());
+
+    // Wait for the result, the deadline, or a key.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(completion_deadline_);
+    struct pollfd fds[2] = {
+        {STDIN_FILENO, POLLIN, 0},
+        {completion_runner_->notify_fd(), POLLIN, 0},
+    };
+    while (!completion_runner_->done()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            break;
+        }
+        int n = ::poll(fds, 2, remaining.count());
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+        if (n > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            completion_runner_->finish(sink);
+            sink.clear();
+            return -1;
+        }
+    }
+    return completion_runner_->finish(sink) ? 1 : 0;
+}
+
+void Application::set_completion_deadline(unsigned milliseconds)
+{
+    completion_deadline_ = milliseconds;
+}
+
+bool Application::completion_cancelled()
+{
+    return detail::CompletionRunner::cancelled();
+}
+
+void Application::report_completion(const std::vector<CompletionItem> &candidates)
+{
+    detail::CompletionRunner::report(candidates);
+}
+
 wchar_t *prompt_handler(EditLine *editline)
 {
     Application *self = nullptr;
@@ -138,18 +323,155 @@ wchar_t *prompt_handler(EditLine *editline)
     return const_cast<wchar_t *>(self->get_prompt().c_str());
 }
 
+// Read a character like the default read function of editline, and print the finished jobs meanwhile.
+int getc_handler(EditLine *editline, wchar_t *ch)
+{
+    Application *self = nullptr;
+    el_wget(editline, EL_CLIENTDATA, &self);
+
+    mbstate_t state;
+    memset(&state, 0, sizeof(state));
+    struct pollfd fds[2] = {
+        {STDIN_FILENO, POLLIN, 0},
+        {self->jobs().notify_fd(), POLLIN, 0},
+    };
+    while (true) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (fds[1].revents & POLLIN) {
+            // print above the prompt, then redraw the prompt and the input
+            Output &out = self->out();
+            if (isatty(STDOUT_FILENO))
+                out.write(Output::OUT, "\r\033[K", 4); // clear the input line
+            self->jobs().report(out);
+            out.flush();
+            el_wset(editline, EL_REFRESH);
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char c;
+            ssize_t n = ::read(STDIN_FILENO, &c, 1);
+            if (n == 0) {
+                return 0;
+            }
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                return -1;
+            }
+            size_t ret = mbrtowc(ch, &c, 1, &state);
+            if (ret == (size_t)-2) // incomplete multibyte character
+                continue;
+            if (ret == (size_t)-1) { // invalid byte, pass it through
+                memset(&state, 0, sizeof(state));
+                *ch = (unsigned char)c;
+            }
+            return 1;
+        }
+    }
+}
+
+// Incremental reverse search like em-inc-search-prev, but in the HistoryStore.
+el_action_t Application::search_handler(EditLine *editline, wint_t /*ch*/)
+{
+    Application *self = nullptr;
+    el_wget(editline, EL_CLIENTDATA, &self);
+    self->install_history(true);
+    const detail::HistoryStore *store = self->el_->store_.get();
+    if (!store) {
+        return CC_ERROR;
+    }
+
+    const LineInfoW *line_info = el_wline(editline);
+    const std::wstring original(line_info->buffer, line_info->lastchar);
+    std::wstring query;
+    std::wstring match = original;
+    long found = -1; // index of the match
+    bool failed = false;
+    Output &out = self->out();
+    while (true) {
+        out.printf("\r\033[K(%sreverse-i-search)`%ls': %ls", failed ? "failed " : "", query.c_str(), match.c_str());
+        out.flush();
+
+        wchar_t ch;
+        if (el_wgetc(editline, &ch) != 1) {
+            ch = L'\a'; // like ctrl-g
+        }
+        long next = -1;
+        if (ch == 0x12) { // ctrl-r, search older
+            if (query.empty() || found < 0)
+                continue;
+            next = store->search(query, found);
+        }
+        else if (ch == 0x7f || ch == L'\b') {
+            if (!query.empty())
+                query.pop_back();
+            next = store->search(query, store->size());
+        }
+        else if (ch == L'\a') { // ctrl-g, give up
+            match = original;
+            break;
+        }
+        else if (ch == 0x1b) { // escape, accept
+            break;
+        }
+        else if (ch < 0x20) { // e.g. enter, accept and run the key
+            const wchar_t key[2] = {ch, 0};
+            el_wpush(editline, key);
+            break;
+        }
+        else {
+            query += ch;
+            // the current match may still match
+            next = store->search(query, found >= 0 ? found + 1 : store->size());
+        }
+
+        failed = (next < 0 && !query.empty());
+        if (next >= 0) {
+            found = next;
+            match = store->entry(found);
+        }
+        else if (query.empty()) {
+            found = -1;
+            match = original;
+        }
+    }
+    out.write(Output::OUT, "\r\033[K", 4);
+    out.flush();
+
+    line_info = el_wline(editline);
+    el_cursor(editline, line_info->lastchar - line_info->cursor);
+    el_deletestr(editline, line_info->lastchar - line_info->buffer);
+    el_winsertstr(editline, match.c_str());
+    return CC_REDISPLAY;
+}
+
 void Application::init(const char *prog_name, std::unique_ptr<CommandContext> context, const std::string &history_file)
 {
     history_file_ = history_file;
-    context_ = std::move(context);
+    session_->context = std::move(context);
 
     setlocale(LC_ALL, "");
 
-    HistoryW *history = history_winit();
-    HistEventW event;
-    history_w(history, &event, H_SETSIZE, 1000); // remember 1000 events
-    history_w(history, &event, H_LOAD, history_file_.c_str()); // load histroy
-    history_w(history, &event, H_SETUNIQUE, 1); // adjacent identical event strings should not be entered into the history
+    // Load the history in the background, so that the prompt appears at once. The commands entered
+    // meanwhile go to an empty history, which is replaced by install_history().
+    HistoryW *history = new_history();
+    el_->history_loader_ = std::thread([this] {
+        std::unique_ptr<detail::HistoryStore> store(new detail::HistoryStore);
+        store->open(history_file_); // without the file, the history of this run is not saved
+        // editline browses only the recent commands
+        HistoryW *loaded = new_history();
+        HistEventW event;
+        size_t size = store->size();
+        for (size_t i = (size > 1000) ? size - 1000 : 0; i < size; i++) {
+            history_w(loaded, &event, H_ENTER, (store->entry(i) + L"\n").c_str());
+        }
+        el_->loaded_history_ = loaded;
+        el_->loaded_store_ = std::move(store);
+        el_->history_loaded_ = true;
+    });
 
     EditLine *editline = el_init(prog_name, stdin, stdout, stderr);
     el_wset(editline, EL_SIGNAL, 1); // handle signals gracefully
@@ -168,8 +490,9 @@ void Application::init(const char *prog_name, std::unique_ptr<CommandContext> co
     el_wset(editline, EL_BIND, L"^I", L"ed-complete", NULL);
     // for reference:  https://github.com/seanchann/libcutil (libcutil/src/core/elhelper.c)
 
-    // Bind ctrl-r to builtin command em-inc-search-prev
-    el_wset(editline, EL_BIND, L"^R", L"em-inc-search-prev", NULL);
+    // Bind ctrl-r to search_handler(), which searches all the history instead of the recent commands
+    el_wset(editline, EL_ADDFN, L"exole-search", L"Search history", search_handler);
+    el_wset(editline, EL_BIND, L"^R", L"exole-search", NULL);
 
     // Let ctrl-w delete just the previous word, otherwise it will delete to the beginning.
     el_wset(editline, EL_BIND, L"^W", L"ed-delete-prev-word", NULL);
@@ -183,121 +506,293 @@ void Application::init(const char *prog_name, std::unique_ptr<CommandContext> co
 
 void Application::run()
 {
+    Output *old_output = Output::set_current(&session_->output);
     current_console()->on_enter_console(*this);
     while (true) {
+        install_history(false);
+        jobs_->report(session_->output);
+        session_->output.flush();
         const wchar_t *line = NULL;
         int num = 0;
         line = el_wgets(el_->editline_, &num);
         if (line == NULL || num == 0) {
+            if (session_->tokenizer->incomplete()) { // end of input in the middle of a command
+                session_->output.put(Output::OUT, '\n');
+                discard_partial_command();
+                continue;
+            }
             leave_console();
-            if (console_stack_.empty()) {
+            if (session_->console_stack.empty()) {
                 break;
             }
             else {
-                printf("\n");
+                session_->output.put(Output::OUT, '\n');
                 current_console()->on_enter_console(*this);
                 continue;
             }
         }
 
+        // Only the new line is tokenized, the tokenizer keeps the state of an incomplete command.
+        int ret = session_->tokenizer->feed(line, num);
+        if (ret > 0) { // need to read more lines until quotes are matched
+            session_->partial_line.append(line, num);
+            continue;
+        }
+        if (!session_->partial_line.empty()) {
+            session_->partial_line.append(line, num);
+            line = session_->partial_line.c_str();
+        }
+
         if (wcslen(line) != 0 && 0 != wcscmp(L"\n", line)) {
             HistEventW event;
             history_w(el_->history_, &event, H_ENTER, line);
+            if (el_->store_)
+                el_->store_->append(line); // saved at once, in case of a crash
         }
+        session_->partial_line.clear();
 
-        TokenizerW *tok = tok_winit(NULL);
-        EXOLE_SCOPE_EXIT(tok, [](TokenizerW *t) { tok_wend(t); });
-
-        int argc;
-        const wchar_t **argv;
-        int ret = tok_wstr(tok, line, &argc, &argv);
-        if (ret < 0) { // internal error
-            fprintf(stderr, "failed to parse input (internal error)\n");
-            continue;
+        if (completion_runner_) {
+            completion_runner_->wait_idle(); // a timed out completion may still be using the commands
         }
-        else if (ret > 0) { // need to read more lines until quotes are matched
-            // TODO
+        // Take the tokenizer while the command runs, like run_command() does.
+        std::unique_ptr<detail::ArgvTokenizer> tokenizer = std::move(session_->tokenizer);
+        int argc = tokenizer->argc();
+        const wchar_t **argv = tokenizer->argv();
+        if (tokenizer->is_background()) {
+            run_in_background(argc - 1, argv);
         }
-        else { // ret == 0, successful
+        else {
             current_console()->run(*this, argc, argv);
         }
+        session_->tokenizer = std::move(tokenizer);
     }
+    session_->output.flush();
+    Output::set_current(old_output);
+}
+
+void Application::install_history(bool wait)
+{
+    if (!el_->history_loader_.joinable() || (!wait && !el_->history_loaded_)) {
+        return;
+    }
+    el_->history_loader_.join();
+    HistoryW *loaded = el_->loaded_history_;
+    el_->loaded_history_ = nullptr;
+    el_->store_ = std::move(el_->loaded_store_);
+
+    // append the commands entered while loading, from the oldest one
+    HistEventW event;
+    std::vector<std::wstring> entered;
+    for (int ret = history_w(el_->history_, &event, H_LAST); ret != -1; ret = history_w(el_->history_, &event, H_PREV)) {
+        entered.push_back(event.str);
+    }
+    for (const auto &line : entered) {
+        history_w(loaded, &event, H_ENTER, line.c_str());
+        el_->store_->append(line);
+    }
+    el_wset(el_->editline_, EL_HIST, history_w, loaded);
+    history_wend(el_->history_);
+    el_->history_ = loaded;
 }
 
 void Application::init_batch_mode(const char * /*prog_name*/, std::unique_ptr<CommandContext> context)
 {
     is_batch_mode_ = true;
 
-    context_ = std::move(context);
+    session_->context = std::move(context);
     setlocale(LC_ALL, "");
 
+    Output *old_output = Output::set_current(&session_->output);
     current_console()->on_enter_console(*this);
+    session_->output.flush();
+    Output::set_current(old_output);
+}
+
+void Application::run_in_background(int argc, const wchar_t **argv)
+{
+    // resolve the command like Console::run()
+    Console *parent = current_console();
+    Command *command = nullptr;
+    int i = 0;
+    while (i < argc && !command) {
+        Command *next = parent->command_manager().find_command(argv[i]);
+        if (!next) {
+            break;
+        }
+        i++;
+        Console *sub_console = dynamic_cast<Console *>(next);
+        if (sub_console)
+            parent = sub_console;
+        else
+            command = next;
+    }
+    if (!command || !command->is_reentrant()) {
+        session_->output.eprintf("ERROR: only re-entrant commands can run in the background\n");
+        return;
+    }
+
+    if (!job_notifications_ && el_->editline_) {
+        el_wset(el_->editline_, EL_GETCFN, getc_handler);
+        job_notifications_ = true;
+    }
+    std::wstring command_line;
+    for (int j = 0; j < argc; j++) {
+        command_line += (j == 0) ? L"" : L" ";
+        command_line += argv[j];
+    }
+    int id = jobs_->start(*this, parent, command, argc - i, argv + i, command_line);
+    session_->output.printf("[%d] %ls\n", id, command_line.c_str());
+}
+
+bool Application::serve(const char *socket_path, std::function<std::unique_ptr<CommandContext>()> context_factory)
+{
+    setlocale(LC_ALL, "");
+
+    detail::Server server(*this, context_factory);
+    if (!server.listen(socket_path)) {
+        return false;
+    }
+    serving_ = true;
+    server.run();
+    serving_ = false;
+    return true;
 }
 
 void Application::run_command(const std::wstring &line)
 {
-    if (line.empty()) {
+    bool continued = has_partial_command();
+    if (line.empty() && !continued) {
         return;
     }
 
-    TokenizerW *tok = tok_winit(NULL);
-    EXOLE_SCOPE_EXIT(tok, [](TokenizerW *t) { tok_wend(t); });
-
-    int argc;
-    const wchar_t **argv;
-    int ret = tok_wstr(tok, line.c_str(), &argc, &argv);
-
-    // partial input is not supported in batch mode
-    switch (ret) {
-    case 0: // successful
-        break;
-    case -1: // internal error
-        fprintf(stderr, "failed to parse command: internal error\n");
-        break;
-    case 1: // unmatched single quote
-        fprintf(stderr, "failed to parse command: unmatched single quote\n");
-        break;
-    case 2: // unmatched double quote
-        fprintf(stderr, "failed to parse command: unmatched double quote\n");
-        break;
-    case 3: // backslash quoted
-        fprintf(stderr, "failed to parse command: backslash quoted\n");
-        break;
-    default: // undocumented error
-        fprintf(stderr, "failed to parse command: unknown error %d\n", ret);
-        break;
-    }
-    if (ret != 0)
+    // Take the tokenizer while the command runs: if the command calls run_command() again,
+    // that call gets a new tokenizer, and does not overwrite the arguments of this command.
+    std::unique_ptr<detail::ArgvTokenizer> tokenizer = std::move(session_->tokenizer);
+    if (!tokenizer) {
+        tokenizer.reset(new detail::ArgvTokenizer());
+    }
+    if (continued) {
+        tokenizer->feed(L"\n", 1); // the lines are joined with newlines
+    }
+    if (tokenizer->feed(line.c_str(), line.size()) != detail::ArgvTokenizer::OK) {
+        // the command continues on the next line
+        session_->tokenizer = std::move(tokenizer);
         return;
+    }
+
+    Output *old_output = Output::set_current(&session_->output);
+    current_console()->run(*this, tokenizer->argc(), tokenizer->argv());
+    session_->tokenizer = std::move(tokenizer);
+    Output::set_current(old_output);
+    if (!old_output) // not nested in another command
+        session_->output.flush();
+}
+
+bool Application::has_partial_command() const
+{
+    return session_->tokenizer && session_->tokenizer->incomplete();
+}
+
+void Application::discard_partial_command()
+{
+    if (!has_partial_command()) {
+        return;
+    }
+    Output *old_output = Output::set_current(&session_->output);
+    session_->output.eprintf("failed to parse command: %s\n", detail::ArgvTokenizer::status_message(session_->tokenizer->status()));
+    Output::set_current(old_output);
+    if (!old_output)
+        session_->output.flush();
+    session_->tokenizer->reset();
+    session_->partial_line.clear();
+}
 
-    current_console()->run(*this, argc, argv);
+void Application::run_script(const BatchScript &script)
+{
+    Output *old_output = Output::set_current(&session_->output);
+    for (const BatchScript::Step &step : script.steps_) {
+        switch (step.kind) {
+        case BatchScript::SK_RUN: {
+            EXOLE_STATS_TIME(stats().entry(step.parent, step.command)->run);
+            step.command->run(*this, step.argc, step.argv);
+            break;
+        }
+        case BatchScript::SK_ENTER:
+            step.command->run(*this, 0, step.argv);
+            break;
+        case BatchScript::SK_LINE:
+            current_console()->run(*this, step.argc, step.argv);
+            break;
+        }
+        if (!old_output) // not nested in another command
+            session_->output.flush();
+    }
+    Output::set_current(old_output);
+}
+
+CommandStatus Application::resolve_command(const wchar_t *const *path, size_t len, CommandHandle *handle) const
+{
+    *handle = CommandHandle();
+    Console *console = root_.get();
+    Command *command = console;
+    for (size_t i = 0; i < len; i++) {
+        if (!console) {
+            return CS_NOT_A_CONSOLE;
+        }
+        command = console->command_manager().find_command(path[i]);
+        if (!command) {
+            return CS_NOT_FOUND;
+        }
+        console = dynamic_cast<Console *>(command);
+    }
+    *handle = CommandHandle(command);
+    return CS_OK;
+}
+
+CommandStatus Application::resolve_command(std::initializer_list<const wchar_t *> path, CommandHandle *handle) const
+{
+    return resolve_command(path.begin(), path.size(), handle);
+}
+
+CommandStatus Application::invoke(const CommandHandle &handle, int argc, const wchar_t **argv)
+{
+    if (!handle.valid()) {
+        return CS_INVALID_HANDLE;
+    }
+    handle.command()->run(*this, argc, argv);
+    return CS_OK;
 }
 
 void Application::enter_console(Console *console)
 {
-    console_stack_.push_back(console);
+    session_->console_stack.push_back(console);
     update_prompt();
 }
 
 void Application::leave_console()
 {
-    console_stack_.back()->on_leave_console(*this);
-    console_stack_.pop_back();
+    session_->console_stack.back()->on_leave_console(*this);
+    session_->console_stack.pop_back();
     update_prompt();
 }
 
 void Application::update_prompt()
 {
-    prompt_.clear();
-    for (size_t i = 0; i < console_stack_.size(); i++) {
-        Console *console = console_stack_[i];
+    session_->prompt.clear();
+    for (size_t i = 0; i < session_->console_stack.size(); i++) {
+        Console *console = session_->console_stack[i];
         std::wstring name = console->get_prompt(*this);
-        if (!prompt_.empty()) {
-            prompt_ += L'/';
+        if (!session_->prompt.empty()) {
+            session_->prompt += L'/';
         }
-        prompt_ += name;
+        session_->prompt += name;
     }
-    prompt_ += L"> ";
+    session_->prompt += L"> ";
+}
+
+const std::wstring &Application::get_prompt() const
+{
+    return has_partial_command() ? continuation_prompt_ : session_->prompt;
 }
 
 void Application::set_default_prompt(const std::wstring &prompt)
@@ -330,7 +825,7 @@ bool Application::get_window_size(unsigned *rows, unsigned *cols)
 
 int Application::getc(wchar_t *ch)
 {
-    if (is_batch_mode_) // editline is N/A
+    if (is_batch_mode_ || !el_->editline_) // editline is N/A, e.g. in batch mode or server mode
         return -1;
     else
         return el_wgetc(el_->editline_, ch);
@@ -4,8 +4,16 @@
 #include "command.h"
 #include "command_manager.h"
 #include "command_context.h"
+#include "command_handle.h"
+#include "output.h"
+#include <cwchar>
+#include <functional>
+#include <initializer_list>
 #include <memory>
 
+struct editline;
+typedef struct editline EditLine; // from histedit.h
+
 namespace exole {
 
 typedef unsigned char el_action_t;
@@ -13,6 +21,15 @@ typedef unsigned char el_action_t;
 class Console;
 class RootConsole;
 class EditlineWrapper;
+class CommandStats;
+class BatchScript;
+class JobTable;
+
+namespace detail {
+struct Session;
+class Server;
+class CompletionRunner;
+}
 
 class Application
 {
@@ -23,18 +40,66 @@ public:
     void run();
 
     void init_batch_mode(const char *prog_name, std::unique_ptr<CommandContext> context);
+    /// A command can continue on the next line, if the line ends in quotes or with a backslash.
     void run_command(const std::wstring &line); // for batch mode only
+    /// \return true if the lines passed to run_command() end with an incomplete command.
+    bool has_partial_command() const;
+    /// Report and discard an incomplete command, e.g. at the end of a batch file.
+    void discard_partial_command();
+    /// Replay a compiled batch script, for batch mode only. See BatchScript.
+    void run_script(const BatchScript &script);
 
     bool is_batch_mode() const { return is_batch_mode_; }
 
+    /// Serve console sessions on a Unix domain socket, until stop_serving() is called.
+    /// Each connection has its own console stack, prompt and context, created by \a context_factory ,
+    /// while the commands are shared. The commands of all sessions run one at a time on the calling thread.
+    /// A connection sends commands line by line, and a line of a single Ctrl-D (\x04) leaves the current
+    /// console, just like Ctrl-D in run(). See usage in \c example/server.cpp and \c example/client.cpp .
+    /// \return false if the socket cannot be created.
+    bool serve(const char *socket_path, std::function<std::unique_ptr<CommandContext>()> context_factory);
+    /// Make serve() return after the current command.
+    void stop_serving() { serving_ = false; }
+
+    /// Resolve a command path from the root console, e.g. {L"hex", L"next"}.
+    /// Errors are returned rather than printed.
+    CommandStatus resolve_command(const wchar_t *const *path, size_t len, CommandHandle *handle) const;
+    CommandStatus resolve_command(std::initializer_list<const wchar_t *> path, CommandHandle *handle) const;
+
+    /// Run a resolved command with pre-tokenized arguments, as if it were typed after its command path.
+    CommandStatus invoke(const CommandHandle &handle, int argc, const wchar_t **argv);
+
     CommandManager &command_manager();
     void enter_console(Console *console);
     void leave_console();
-    Console *current_console() const { return console_stack_.back(); }
-    CommandContext *context() { return context_.get(); }
+    Console *current_console() const;
+    CommandContext *context();
+
+    /// Where commands should print to. This is the output of the application unless another output is
+    /// installed for the calling thread, e.g. by BatchExecutor. It is flushed after each command.
+    Output &out();
+
     void set_default_prompt(const std::wstring &prompt);
     void update_prompt();
-    const std::wstring &get_prompt() const { return prompt_; }
+    /// The prompt to show, which is the continuation prompt while a command is incomplete.
+    const std::wstring &get_prompt() const;
+    void set_continuation_prompt(const std::wstring &prompt) { continuation_prompt_ = prompt; }
+
+    /// Latencies of commands, recorded when the library is built with EXOLE_ENABLE_STATS.
+    CommandStats &stats() { return *stats_; }
+
+    /// Commands running in the background, started like "command &" in run().
+    JobTable &jobs() { return *jobs_; }
+
+    /// Complete on a helper thread, so that a slow completer does not freeze the keyboard. The completion
+    /// is given up when a key is pressed, or after \a milliseconds , when the candidates reported by
+    /// report_completion() so far are shown. Commands wait for a given up completion to return, so slow
+    /// completers should check completion_cancelled(). The default 0 completes on the terminal thread.
+    void set_completion_deadline(unsigned milliseconds);
+    /// \return true if the completion running on the calling thread has been given up.
+    static bool completion_cancelled();
+    /// Report candidates found so far by a slow completer, to be shown if the deadline passes.
+    static void report_completion(const std::vector<CompletionItem> &candidates);
 
     /// Get the size of the terminal window.
     static bool get_window_size(unsigned *rows, unsigned *cols);
@@ -42,13 +107,36 @@ public:
     /// \return the number of characters read if successful, -1 otherwise.
     int getc(wchar_t *ch);
 private:
+    friend class Console;
+    friend class detail::Server;
+
+    detail::Session &session() { return *session_; }
+
+    /// Replace the history with the one loaded in the background, if it has been loaded.
+    /// \param wait wait for the history to be loaded.
+    void install_history(bool wait);
+    /// Complete the line on the current console with completion_runner_.
+    static el_action_t complete_handler(EditLine *editline, wint_t ch);
+    /// \return 1 if completed, 0 if the deadline has passed, or -1 if cancelled by a key.
+    int complete_in_background(const wchar_t *line, size_t len, size_t cursor, CompletionSink &sink);
+    /// Search the history for ctrl-r.
+    static el_action_t search_handler(EditLine *editline, wint_t ch);
+    /// Run a re-entrant command on a worker thread.
+    void run_in_background(int argc, const wchar_t **argv);
+
     std::unique_ptr<EditlineWrapper> el_;
     std::unique_ptr<RootConsole> root_;
-    std::vector<Console *> console_stack_;
-    std::unique_ptr<CommandContext> context_;
-    std::wstring prompt_;
+    std::unique_ptr<CommandStats> stats_;
+    std::unique_ptr<JobTable> jobs_;
+    std::unique_ptr<detail::CompletionRunner> completion_runner_;
+    std::unique_ptr<detail::Session> main_session_;
+    detail::Session *session_; // the session running commands
+    std::wstring continuation_prompt_;
     std::string history_file_;
+    unsigned completion_deadline_; // in milliseconds
     bool is_batch_mode_;
+    bool serving_;
+    bool job_notifications_; // notify finished jobs while reading input
 };
 
 } // namespace exole
@@ -0,0 +1,138 @@
+#include "batch_executor.h"
+#include "application.h"
+#include "console.h"
+#include "output.h"
+#include "detail/argv_tokenizer.h"
+#include "detail/stats_timer.h"
+#include "detail/thread_pool.h"
+#include <thread>
+#include <vector>
+
+namespace exole {
+
+struct BatchExecutor::Job
+{
+    Console *parent;
+    Command *command;
+    std::vector<std::wstring> args;
+    Output output;
+    bool done;
+
+    Job(Console *console, Command *cmd, int argc, const wchar_t **argv)
+    : parent(console)
+    , command(cmd)
+    , args(argv, argv + argc)
+    , done(false)
+    {}
+};
+
+BatchExecutor::BatchExecutor(Application &app, unsigned num_workers)
+: app_(app)
+, tokenizer_(new detail::ArgvTokenizer())
+{
+    if (num_workers == 0)
+        num_workers = std::thread::hardware_concurrency();
+    pool_.reset(new detail::ThreadPool(num_workers));
+    // bound the memory used by buffered output
+    max_pending_ = 64 * pool_->size();
+}
+
+BatchExecutor::~BatchExecutor()
+{
+    finish();
+}
+
+void BatchExecutor::run_command(const std::wstring &line)
+{
+    if (app_.has_partial_command()) {
+        // the line continues an incomplete command
+        flush(true);
+        app_.run_command(line);
+        return;
+    }
+    if (line.empty()) {
+        return;
+    }
+
+    int ret = tokenizer_->tokenize(line.c_str(), line.size());
+    int argc = tokenizer_->argc();
+    const wchar_t **argv = tokenizer_->argv();
+
+    int num_consumed = 0;
+    Console *parent = nullptr;
+    Command *command = (ret == 0) ? resolve(argc, argv, &num_consumed, &parent) : nullptr;
+    if (!command) {
+        // Run in order. Application::run_command() also keeps an incomplete command for the next line.
+        flush(true);
+        app_.run_command(line);
+        return;
+    }
+
+    auto job = std::make_shared<Job>(parent, command, argc - num_consumed, argv + num_consumed);
+    pending_.push_back(job);
+    pool_->submit([this, job] {
+        std::vector<const wchar_t *> args;
+        args.reserve(job->args.size());
+        for (const auto &a : job->args) {
+            args.push_back(a.c_str());
+        }
+        Output *old = Output::set_current(&job->output);
+        {
+            EXOLE_STATS_TIME(app_.stats().entry(job->parent, job->command)->run);
+            job->command->run(app_, args.size(), args.data());
+        }
+        Output::set_current(old);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->done = true;
+        done_cond_.notify_all();
+    });
+    flush(false);
+}
+
+void BatchExecutor::finish()
+{
+    flush(true);
+}
+
+Command *BatchExecutor::resolve(int argc, const wchar_t **argv, int *num_consumed, Console **parent) const
+{
+    // Follow the same path as Console::run(), e.g. "hex next 10" resolves to the "next" command of console "hex".
+    Console *console = app_.current_console();
+    int i = 0;
+    while (i < argc) {
+        Command *command = console->command_manager().find_command(argv[i]);
+        if (!command) { // handled by Console::custom_run()
+            return nullptr;
+        }
+        i++;
+        Console *sub_console = dynamic_cast<Console *>(command);
+        if (!sub_console) {
+            *num_consumed = i;
+            *parent = console;
+            return command->is_reentrant() ? command : nullptr;
+        }
+        console = sub_console;
+    }
+    // entering a console, or an empty line
+    return nullptr;
+}
+
+void BatchExecutor::flush(bool wait_all)
+{
+    while (!pending_.empty()) {
+        std::shared_ptr<Job> job = pending_.front();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!job->done) {
+                if (!wait_all && pending_.size() <= max_pending_)
+                    return;
+                done_cond_.wait(lock, [&job] { return job->done; });
+            }
+        }
+        job->output.flush();
+        pending_.pop_front();
+    }
+}
+
+} // namespace exole
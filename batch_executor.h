@@ -0,0 +1,65 @@
+#ifndef EXOLE_BATCH_EXECUTOR_H
+#define EXOLE_BATCH_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace exole {
+
+class Application;
+class Command;
+class Console;
+
+namespace detail {
+class ArgvTokenizer;
+class ThreadPool;
+}
+
+/**
+ * BatchExecutor runs batch mode commands on a pool of worker threads.
+ *
+ * A command line is run on a worker if it resolves to a re-entrant command (see Command::is_reentrant()),
+ * otherwise BatchExecutor waits for the queued commands and runs it on the calling thread, just like
+ * Application::run_command(). So non re-entrant commands and entering consoles still happen in order.
+ *
+ * Output written with Application::out() or out_printf()/err_printf() is buffered per command and printed
+ * in the order the commands were submitted.
+ */
+class BatchExecutor
+{
+public:
+    /// \param num_workers number of worker threads, 0 means std::thread::hardware_concurrency().
+    explicit BatchExecutor(Application &app, unsigned num_workers = 0);
+    /// Calls finish().
+    ~BatchExecutor();
+
+    void run_command(const std::wstring &line);
+
+    /// Wait for all queued commands and print their output.
+    void finish();
+
+private:
+    struct Job;
+
+    /// \return the command to run on a worker, or nullptr if the line must run on the calling thread.
+    Command *resolve(int argc, const wchar_t **argv, int *num_consumed, Console **parent) const;
+
+    /// Print the output of finished jobs in order.
+    /// \param wait_all wait for all jobs if true, otherwise only wait while there are too many pending jobs.
+    void flush(bool wait_all);
+
+    Application &app_;
+    std::unique_ptr<detail::ArgvTokenizer> tokenizer_;
+    std::unique_ptr<detail::ThreadPool> pool_;
+    std::deque<std::shared_ptr<Job>> pending_; // in submission order
+    size_t max_pending_;
+    std::mutex mutex_;
+    std::condition_variable done_cond_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_BATCH_EXECUTOR_H
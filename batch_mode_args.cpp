@@ -1,16 +1,40 @@
 #include "batch_mode_args.h"
-#include <fstream>
+#include "batch_source.h"
+#include "wcs_util.h"
+#include "detail/argv_tokenizer.h"
 #include <cassert>
 #include <cstring>
+#include <cstdlib>
 
 namespace exole {
 
 BatchModeArgs::BatchModeArgs()
-: batch_mode_enabled_(false)
+: jobs_(1)
+, batch_mode_enabled_(false)
 {
 }
 
-bool BatchModeArgs::parse(int &argc, char **argv, char batch_option, char exec_option, char file_option)
+bool BatchModeArgs::add_argument(char opt, const char *arg, char exec_option, char file_option)
+{
+    if (opt == exec_option) {
+        commands_.push_back(arg);
+    }
+    else if (opt == file_option) {
+        files_.push_back(arg);
+    }
+    else { // jobs option
+        char *end = nullptr;
+        long jobs = strtol(arg, &end, 10);
+        if (*arg == '\0' || *end != '\0' || jobs < 0) {
+            fprintf(stderr, "error: invalid argument for option -%c: %s\n", opt, arg);
+            return false;
+        }
+        jobs_ = jobs;
+    }
+    return true;
+}
+
+bool BatchModeArgs::parse(int &argc, char **argv, char batch_option, char exec_option, char file_option, char jobs_option)
 {
     int fast = 0, slow = 0;
 
@@ -60,15 +84,12 @@ bool BatchModeArgs::parse(int &argc, char **argv, char batch_option, char exec_o
                 }
                 type = OPTION_0;
             }
-            else if (exec_option == opt || file_option == opt) {
+            else if (exec_option == opt || file_option == opt || jobs_option == opt) {
                 type = OPTION_1;
                 if (len > 2) { // e.g. "-xcommand" or "-f/tmp/commands.txt"
                     type = OPTION_0;
-                    const char *opt_arg = arg + 2;
-                    if (exec_option == opt)
-                        commands_.push_back(opt_arg);
-                    else
-                        files_.push_back(opt_arg);
+                    if (!add_argument(opt, arg + 2, exec_option, file_option))
+                        num_errors++;
                 }
             }
             else {
@@ -124,12 +145,8 @@ bool BatchModeArgs::parse(int &argc, char **argv, char batch_option, char exec_o
                 break;
             case ARGUMENT:
                 state = EXPECT_MAYBE_OPTION;
-                if (last_opt == exec_option) {
-                    commands_.push_back(arg);
-                }
-                else {
-                    files_.push_back(arg);
-                }
+                if (!add_argument(last_opt, arg, exec_option, file_option))
+                    num_errors++;
                 to_consume = true;
                 break;
             case DOUBLE_DASH:
@@ -166,33 +183,27 @@ bool BatchModeArgs::parse(int &argc, char **argv, char batch_option, char exec_o
     return num_errors == 0;
 }
 
-static bool is_empty_or_comment(const std::string &line)
-{
-    size_t pos = line.find_first_not_of(" \t");
-    if (pos == line.npos) { // is empty line
-        return true;
-    }
-    if (line[pos] == '#') { // is comment
-        return true;
-        // XXX: what if somebody wants a command starting with '#'?
-    }
-    return false;
-}
-
 bool BatchModeArgs::load_commands(const char *filename, std::deque<std::string> &commands)
 {
-    std::ifstream ifs(filename);
-    if (!ifs) {
-        fprintf(stderr, "cannot open file '%s'\n", filename);
+    BatchSource source;
+    if (!source.open(std::vector<const char *>(1, filename))) {
         return false;
     }
+    // Follow the commands, to keep blank lines and comments in quoted arguments spanning lines.
+    detail::ArgvTokenizer tokenizer;
     std::string line;
-    while (std::getline(ifs, line)) {
-        if (is_empty_or_comment(line))
+    while (source.next(line)) {
+        if (!tokenizer.incomplete() && BatchSource::is_empty_or_comment(line.data(), line.size())) {
             continue;
+        }
+        std::wstring wline = mbs_to_wcs(line);
+        if (tokenizer.incomplete()) {
+            tokenizer.feed(L"\n", 1);
+        }
+        tokenizer.feed(wline.c_str(), wline.size());
         commands.push_back(line);
     }
-    return true;
+    return !source.failed();
 }
 
 bool BatchModeArgs::load_commands()
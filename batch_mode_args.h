@@ -26,7 +26,10 @@ class BatchModeArgs
 public:
     BatchModeArgs();
 
-    bool parse(int &argc, char **argv, char batch_option, char exec_option, char file_option);
+    /// \param jobs_option the option that sets the number of worker threads (see BatchExecutor), '\0' if unused.
+    bool parse(int &argc, char **argv, char batch_option, char exec_option, char file_option, char jobs_option = '\0');
+    /// Load all commands from the files into file_commands().
+    /// \note For large files, read the commands incrementally with BatchSource instead.
     bool load_commands();
 
     bool batch_mode_enabled() const { return batch_mode_enabled_; }
@@ -39,12 +42,18 @@ public:
 
     const std::vector<const char *> &files() const { return files_; }
 
+    /// Number of worker threads passed via jobs_option, 1 by default. 0 means one per CPU core.
+    unsigned jobs() const { return jobs_; }
+
     static bool load_commands(const char *filename, std::deque<std::string> &commands);
 
 private:
+    bool add_argument(char opt, const char *arg, char exec_option, char file_option);
+
     std::vector<const char *> commands_;
     std::vector<const char *> files_;
     std::deque<std::string> file_commands_;
+    unsigned jobs_;
     bool batch_mode_enabled_;
 };
 
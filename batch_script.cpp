@@ -0,0 +1,366 @@
+#include "batch_script.h"
+#include "application.h"
+#include "batch_source.h"
+#include "console.h"
+#include "wcs_util.h"
+#include "detail/argv_tokenizer.h"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace exole {
+
+// File layout, in native byte order:
+//   Header
+//   wchar_t  chars[char_count]           interned strings, each null-terminated
+//   uint32_t strings[string_count]       offset of each string in chars
+//   uint32_t paths[path_count + 1]       range of each command path in path_names
+//   uint32_t path_names[path_name_count] string id of each name in command paths
+//   uint32_t args[arg_count]             string id of each argument
+//   Record   records[record_count]
+static const char MAGIC[8] = {'E', 'X', 'O', 'L', 'E', 'B', 'S', '1'};
+static const uint32_t NO_PATH = UINT32_MAX;
+
+namespace {
+
+struct Header
+{
+    char magic[8];
+    uint32_t wchar_size;
+    uint32_t char_count;
+    uint32_t string_count;
+    uint32_t path_count;
+    uint32_t path_name_count;
+    uint32_t arg_count;
+    uint32_t record_count;
+    uint32_t reserved;
+};
+
+struct Record
+{
+    uint32_t kind;
+    uint32_t path;      // command path id, NO_PATH for SK_LINE
+    uint32_t argc;
+    uint32_t arg_start; // index in args
+};
+
+class ScriptWriter
+{
+public:
+    uint32_t intern(const wchar_t *str)
+    {
+        auto result = string_ids_.emplace(str, uint32_t(strings_.size()));
+        if (result.second) {
+            strings_.push_back(chars_.size());
+            chars_.insert(chars_.end(), str, str + wcslen(str) + 1);
+        }
+        return result.first->second;
+    }
+
+    uint32_t add_path(const std::vector<uint32_t> &path)
+    {
+        auto result = path_ids_.emplace(path, uint32_t(paths_.size() - 1));
+        if (result.second) {
+            path_names_.insert(path_names_.end(), path.begin(), path.end());
+            paths_.push_back(path_names_.size());
+        }
+        return result.first->second;
+    }
+
+    void add_record(uint32_t kind, uint32_t path, int argc, const wchar_t **argv)
+    {
+        records_.push_back(Record{kind, path, uint32_t(argc), uint32_t(args_.size())});
+        for (int i = 0; i < argc; i++) {
+            args_.push_back(intern(argv[i]));
+        }
+    }
+
+    bool write(const char *filename) const
+    {
+        FILE *fp = fopen(filename, "wb");
+        if (!fp) {
+            fprintf(stderr, "cannot open file '%s'\n", filename);
+            return false;
+        }
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.wchar_size = sizeof(wchar_t);
+        header.char_count = chars_.size();
+        header.string_count = strings_.size();
+        header.path_count = paths_.size() - 1;
+        header.path_name_count = path_names_.size();
+        header.arg_count = args_.size();
+        header.record_count = records_.size();
+        header.reserved = 0;
+        bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+               && write_array(chars_, fp)
+               && write_array(strings_, fp)
+               && write_array(paths_, fp)
+               && write_array(path_names_, fp)
+               && write_array(args_, fp)
+               && write_array(records_, fp);
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) {
+            fprintf(stderr, "failed to write file '%s'\n", filename);
+        }
+        return ok;
+    }
+
+private:
+    template <typename T>
+    static bool write_array(const std::vector<T> &array, FILE *fp)
+    {
+        return array.empty() || fwrite(array.data(), sizeof(T), array.size(), fp) == array.size();
+    }
+
+    std::vector<wchar_t> chars_;
+    std::vector<uint32_t> strings_;
+    std::vector<uint32_t> paths_ = {0};
+    std::vector<uint32_t> path_names_;
+    std::vector<uint32_t> args_;
+    std::vector<Record> records_;
+    std::unordered_map<std::wstring, uint32_t> string_ids_;
+    std::map<std::vector<uint32_t>, uint32_t> path_ids_;
+};
+
+} // namespace
+
+BatchScript::BatchScript()
+: map_(nullptr)
+, map_size_(0)
+{
+}
+
+BatchScript::~BatchScript()
+{
+    unmap();
+}
+
+void BatchScript::unmap()
+{
+    if (map_) {
+        ::munmap(const_cast<char *>(map_), map_size_);
+    }
+    map_ = nullptr;
+    map_size_ = 0;
+    args_.clear();
+    steps_.clear();
+}
+
+bool BatchScript::compile(Application &app, BatchSource &source, const char *filename)
+{
+    CommandHandle root;
+    app.resolve_command(nullptr, 0, &root);
+
+    ScriptWriter writer;
+    detail::ArgvTokenizer tokenizer;
+    // the console stack as the commands would change it, starting from the root console
+    Console *console = static_cast<Console *>(root.command());
+    std::vector<uint32_t> console_path;
+
+    const char *line;
+    size_t len;
+    while (source.next(&line, &len)) {
+        if (!tokenizer.incomplete() && BatchSource::is_empty_or_comment(line, len)) {
+            continue;
+        }
+        std::wstring wline = mbs_to_wcs(line, len);
+        if (tokenizer.incomplete()) {
+            tokenizer.feed(L"\n", 1); // continue the command like Application::run_command()
+        }
+        else if (wline.empty()) {
+            continue; // Application::run_command() ignores it too
+        }
+        if (tokenizer.feed(wline.c_str(), wline.size()) != detail::ArgvTokenizer::OK) {
+            continue; // the command continues on the next line
+        }
+        int argc = tokenizer.argc();
+        const wchar_t **argv = tokenizer.argv();
+
+        // resolve the line like Console::run()
+        std::vector<uint32_t> path = console_path;
+        Command *command = console;
+        int num_consumed = 0;
+        while (num_consumed < argc) {
+            Console *sub_console = dynamic_cast<Console *>(command);
+            Command *next = sub_console ? sub_console->command_manager().find_command(argv[num_consumed]) : nullptr;
+            if (!next) {
+                break;
+            }
+            path.push_back(writer.intern(argv[num_consumed]));
+            command = next;
+            num_consumed++;
+        }
+
+        Console *sub_console = dynamic_cast<Console *>(command);
+        if (num_consumed == 0 || (sub_console && num_consumed < argc)) {
+            // not a command, left to custom_run() of a console
+            writer.add_record(SK_LINE, NO_PATH, argc, argv);
+        }
+        else if (sub_console) {
+            writer.add_record(SK_ENTER, writer.add_path(path), 0, nullptr);
+            console = sub_console;
+            console_path = path;
+        }
+        else {
+            writer.add_record(SK_RUN, writer.add_path(path), argc - num_consumed, argv + num_consumed);
+        }
+    }
+    if (source.failed()) {
+        return false;
+    }
+    if (tokenizer.incomplete()) {
+        fprintf(stderr, "failed to parse command: %s\n", detail::ArgvTokenizer::status_message(tokenizer.status()));
+        return false;
+    }
+    return writer.write(filename);
+}
+
+bool BatchScript::is_compiled(const char *filename)
+{
+    // Reading a pipe, e.g. /dev/stdin or a FIFO, would consume the bytes BatchSource reads after this.
+    struct stat st;
+    if (::stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(MAGIC)];
+    bool ok = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && ::pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && 0 == memcmp(magic, MAGIC, sizeof(MAGIC));
+    ::close(fd);
+    return ok;
+}
+
+bool BatchScript::load(Application &app, const char *filename)
+{
+    unmap();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open file '%s'\n", filename);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+        void *map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            map_ = (const char *)map;
+            map_size_ = st.st_size;
+        }
+    }
+    ::close(fd);
+    if (!map_) {
+        fprintf(stderr, "cannot map file '%s'\n", filename);
+        return false;
+    }
+
+    auto invalid = [&]() {
+        fprintf(stderr, "invalid batch script '%s'\n", filename);
+        unmap();
+        return false;
+    };
+
+    // locate the sections, and check that they fit in the file
+    const Header *header = (const Header *)map_;
+    size_t offset = sizeof(Header);
+    auto section = [&](size_t count, size_t item_size) -> const char * {
+        const char *p = map_ + offset;
+        offset += count * item_size;
+        return p;
+    };
+    const wchar_t *chars = (const wchar_t *)section(header->char_count, sizeof(wchar_t));
+    const uint32_t *strings = (const uint32_t *)section(header->string_count, sizeof(uint32_t));
+    const uint32_t *paths = (const uint32_t *)section(header->path_count + 1ull, sizeof(uint32_t));
+    const uint32_t *path_names = (const uint32_t *)section(header->path_name_count, sizeof(uint32_t));
+    const uint32_t *args = (const uint32_t *)section(header->arg_count, sizeof(uint32_t));
+    const Record *records = (const Record *)section(header->record_count, sizeof(Record));
+    if (0 != memcmp(header->magic, MAGIC, sizeof(MAGIC)) || header->wchar_size != sizeof(wchar_t)
+            || offset != map_size_ || (header->char_count > 0 && chars[header->char_count - 1] != L'\0')) {
+        return invalid();
+    }
+    for (uint32_t i = 0; i < header->string_count; i++) {
+        if (strings[i] >= header->char_count) {
+            return invalid();
+        }
+    }
+
+    // resolve each argument and each command path once
+    args_.resize(header->arg_count);
+    for (uint32_t i = 0; i < header->arg_count; i++) {
+        if (args[i] >= header->string_count) {
+            return invalid();
+        }
+        args_[i] = chars + strings[args[i]];
+    }
+
+    struct ResolvedPath
+    {
+        Command *command;
+        Console *parent;
+    };
+    std::vector<ResolvedPath> resolved(header->path_count);
+    std::vector<const wchar_t *> names;
+    for (uint32_t i = 0; i < header->path_count; i++) {
+        if (paths[i] >= paths[i + 1] || paths[i + 1] > header->path_name_count) {
+            return invalid();
+        }
+        names.clear();
+        for (uint32_t j = paths[i]; j < paths[i + 1]; j++) {
+            if (path_names[j] >= header->string_count) {
+                return invalid();
+            }
+            names.push_back(chars + strings[path_names[j]]);
+        }
+        CommandHandle command, parent;
+        if (app.resolve_command(names.data(), names.size(), &command) != CS_OK) {
+            std::wstring path;
+            for (auto name : names) {
+                path += path.empty() ? L"" : L" ";
+                path += name;
+            }
+            fprintf(stderr, "batch script '%s': command not found: \"%ls\"\n", filename, path.c_str());
+            unmap();
+            return false;
+        }
+        app.resolve_command(names.data(), names.size() - 1, &parent);
+        resolved[i] = ResolvedPath{command.command(), static_cast<Console *>(parent.command())};
+    }
+
+    steps_.reserve(header->record_count);
+    for (uint32_t i = 0; i < header->record_count; i++) {
+        const Record &record = records[i];
+        bool ok = (record.arg_start <= header->arg_count && record.argc <= header->arg_count - record.arg_start);
+        Step step{StepKind(record.kind), nullptr, nullptr, int(record.argc), args_.data() + record.arg_start};
+        switch (record.kind) {
+        case SK_RUN:
+        case SK_ENTER:
+            ok = ok && record.path < header->path_count;
+            if (ok) {
+                step.command = resolved[record.path].command;
+                step.parent = resolved[record.path].parent;
+            }
+            ok = ok && (record.kind == SK_RUN || dynamic_cast<Console *>(step.command));
+            break;
+        case SK_LINE:
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok) {
+            return invalid();
+        }
+        steps_.push_back(step);
+    }
+    return true;
+}
+
+} // namespace exole
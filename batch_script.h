@@ -0,0 +1,72 @@
+#ifndef EXOLE_BATCH_SCRIPT_H
+#define EXOLE_BATCH_SCRIPT_H
+
+#include <string>
+#include <vector>
+
+namespace exole {
+
+class Application;
+class BatchSource;
+class Command;
+class Console;
+
+/**
+ * BatchScript is a batch mode command file compiled into a binary form, which can be replayed many times
+ * without parsing: the file is memory-mapped, every command is looked up once when it is loaded,
+ * and the arguments are used in place. See usage in \c example/batch_compile.cpp and \c example/batch.cpp .
+ *
+ * Compiling follows the console stack the same way Application::run_command() would, so the script must be
+ * compiled against an application with the same commands as the one replaying it. Commands which change
+ * the console stack themselves (other than entering a console by its name) are not supported.
+ * Lines which do not resolve to a command, e.g. arbitrary input handled by Console::custom_run(),
+ * are replayed on the current console like Application::run_command().
+ */
+class BatchScript
+{
+public:
+    BatchScript();
+    ~BatchScript();
+
+    /// Compile all the commands read from \a source into \a filename .
+    /// \return false if a command cannot be parsed, or the file cannot be written.
+    static bool compile(Application &app, BatchSource &source, const char *filename);
+
+    /// \return true if \a filename is a regular file starting with the magic number of compiled scripts.
+    /// Other files, e.g. pipes, are not read.
+    static bool is_compiled(const char *filename);
+
+    /// Map a compiled script, and resolve its commands in \a app .
+    /// \return false if the file is invalid, or a command is not found.
+    bool load(Application &app, const char *filename);
+
+    size_t size() const { return steps_.size(); }
+
+private:
+    friend class Application;
+
+    enum StepKind {
+        SK_RUN = 1,   // run a command, with the arguments after its path
+        SK_ENTER = 2, // enter a console
+        SK_LINE = 3,  // run the arguments on the current console
+    };
+    struct Step
+    {
+        StepKind kind;
+        Command *command; // nullptr for SK_LINE
+        Console *parent;  // the console which owns command
+        int argc;
+        const wchar_t **argv;
+    };
+
+    void unmap();
+
+    const char *map_;
+    size_t map_size_;
+    std::vector<const wchar_t *> args_; // argv of all steps, pointing into the mapping
+    std::vector<Step> steps_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_BATCH_SCRIPT_H
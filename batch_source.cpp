@@ -0,0 +1,179 @@
+#include "batch_source.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace exole {
+
+static const size_t BUFFER_SIZE = 64 * 1024;
+
+BatchSource::BatchSource()
+: current_(0)
+, begin_(0)
+, end_(0)
+, failed_(false)
+{
+}
+
+BatchSource::~BatchSource()
+{
+    close_all();
+}
+
+void BatchSource::close_all()
+{
+    for (const auto &f : files_) {
+        if (f.map)
+            ::munmap(const_cast<char *>(f.map), f.size);
+        if (f.fd > STDIN_FILENO)
+            ::close(f.fd);
+    }
+    files_.clear();
+}
+
+bool BatchSource::open(const std::vector<const char *> &files)
+{
+    close_all();
+    current_ = 0;
+    begin_ = end_ = 0;
+    failed_ = false;
+    for (auto fn : files) {
+        int fd = (0 == strcmp(fn, "-")) ? STDIN_FILENO : ::open(fn, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "cannot open file '%s'\n", fn);
+            failed_ = true;
+            return false;
+        }
+        File file{fn, fd, nullptr, 0, 0, 0};
+        struct stat st;
+        // stdin redirected from a file may have been read partly, e.g. by a parent process,
+        // so the mapping starts from the page of the current offset.
+        off_t offset = ::lseek(fd, 0, SEEK_CUR);
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 && offset < st.st_size) {
+            off_t map_offset = offset & ~off_t(::sysconf(_SC_PAGESIZE) - 1);
+            size_t map_size = st.st_size - map_offset;
+            void *map = ::mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, map_offset);
+            if (map != MAP_FAILED) {
+                ::madvise(map, map_size, MADV_SEQUENTIAL);
+                file.map = (const char *)map;
+                file.size = map_size;
+                file.pos = offset - map_offset;
+                file.offset = map_offset;
+            }
+            // otherwise fall back to read()
+        }
+        files_.push_back(file);
+    }
+    if (buffer_.empty())
+        buffer_.resize(BUFFER_SIZE);
+    return true;
+}
+
+bool BatchSource::fill()
+{
+    if (begin_ > 0) {
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == buffer_.size()) { // a line longer than the buffer
+        buffer_.resize(buffer_.size() * 2);
+    }
+    ssize_t n;
+    do {
+        n = ::read(files_[current_].fd, buffer_.data() + end_, buffer_.size() - end_);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        fprintf(stderr, "cannot read file '%s': %s\n", files_[current_].name, strerror(errno));
+        failed_ = true;
+        return false;
+    }
+    end_ += n;
+    return n > 0;
+}
+
+bool BatchSource::is_empty_or_comment(const char *line, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len && (line[pos] == ' ' || line[pos] == '\t'))
+        pos++;
+    if (pos == len) { // is empty line
+        return true;
+    }
+    if (line[pos] == '#') { // is comment
+        return true;
+        // XXX: what if somebody wants a command starting with '#'?
+    }
+    return false;
+}
+
+bool BatchSource::next(const char **line, size_t *len)
+{
+    while (!failed_ && current_ < files_.size()) {
+        File &file = files_[current_];
+        if (file.map ? next_mapped(file, line, len) : next_buffered(line, len))
+            return true;
+        current_++;
+    }
+    return false;
+}
+
+bool BatchSource::next_mapped(File &file, const char **line, size_t *len)
+{
+    if (file.pos >= file.size) {
+        // leave the offset of stdin after the input read, as read() would
+        if (file.fd == STDIN_FILENO)
+            ::lseek(file.fd, file.offset + file.size, SEEK_SET);
+        return false;
+    }
+    const char *p = file.map + file.pos;
+    size_t remaining = file.size - file.pos;
+    const char *nl = (const char *)memchr(p, '\n', remaining);
+    size_t n = nl ? size_t(nl - p) : remaining;
+    file.pos += nl ? n + 1 : n;
+    *line = p;
+    *len = n;
+    return true;
+}
+
+bool BatchSource::next_buffered(const char **line, size_t *len)
+{
+    size_t scanned = begin_; // no newline in [begin_, scanned)
+    while (true) {
+        const char *data = buffer_.data();
+        const char *nl = (const char *)memchr(data + scanned, '\n', end_ - scanned);
+        if (nl) {
+            *line = data + begin_;
+            *len = nl - *line;
+            begin_ = scanned = nl + 1 - data;
+            return true;
+        }
+
+        scanned = end_ - begin_; // offset after fill() moves data to the front
+        if (fill())
+            continue;
+        if (failed_)
+            return false;
+
+        // end of the file, the last line may have no newline
+        *line = buffer_.data() + begin_;
+        *len = end_ - begin_;
+        begin_ = end_ = 0;
+        return *len > 0;
+    }
+}
+
+bool BatchSource::next(std::string &line)
+{
+    const char *data;
+    size_t len;
+    if (!next(&data, &len))
+        return false;
+    line.assign(data, len);
+    return true;
+}
+
+} // namespace exole
@@ -0,0 +1,73 @@
+#ifndef EXOLE_BATCH_SOURCE_H
+#define EXOLE_BATCH_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace exole {
+
+/**
+ * BatchSource reads batch mode commands from files incrementally, with a bounded buffer,
+ * so that the first command can run before the whole input is read.
+ *
+ * next() returns every line. Empty lines and comments should be skipped by the caller only between commands,
+ * see is_empty_or_comment(), since they can be part of a quoted argument spanning lines.
+ * The file name "-" stands for stdin, so that commands can be piped from another process.
+ * See usage in \c example/batch.cpp .
+ *
+ * Regular files are memory-mapped, and the lines returned by next() point into the mapping,
+ * so reading a large file needs neither copying nor allocation. Pipes are read through a buffer.
+ */
+class BatchSource
+{
+public:
+    BatchSource();
+    ~BatchSource();
+
+    /// Open all the files, which will be read one after another.
+    /// \return false if any file cannot be opened.
+    bool open(const std::vector<const char *> &files);
+
+    /// Read the next command.
+    /// \param line set to the command, which is valid until the next call.
+    /// \return false at the end of input, or on a read error (see failed()).
+    /// \note The line is not null-terminated.
+    bool next(const char **line, size_t *len);
+    bool next(std::string &line);
+
+    bool failed() const { return failed_; }
+
+    /// Whether a line is empty, or a comment starting with '#', which is skipped unless it continues a command.
+    static bool is_empty_or_comment(const char *line, size_t len);
+
+private:
+    struct File
+    {
+        const char *name;
+        int fd;
+        const char *map; // nullptr if the file is not mapped
+        size_t size;     // size of the mapping
+        size_t pos;      // read position in the mapping
+        off_t offset;    // file offset of the mapping
+    };
+
+    void close_all();
+    /// \return false at the end of the current file.
+    bool next_mapped(File &file, const char **line, size_t *len);
+    bool next_buffered(const char **line, size_t *len);
+    /// Read more data into the buffer.
+    /// \return false at the end of the current file.
+    bool fill();
+    std::vector<File> files_;
+    size_t current_;
+
+    std::vector<char> buffer_;
+    size_t begin_; // start of unconsumed data in buffer_
+    size_t end_;   // end of valid data in buffer_
+    bool failed_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_BATCH_SOURCE_H
@@ -1,20 +1,25 @@
 #ifndef EXOLE_COMMAND_H
 #define EXOLE_COMMAND_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include "command_context.h"
 #include "completion.h"
+#include "completion_sink.h"
 
 namespace exole {
 
 class Application;
+class CommandStats;
+struct CommandStatsEntry;
 
 class Command
 {
 public:
     Command(const std::wstring &name)
     : name_(name)
+    , stats_entry_(nullptr)
     {}
     virtual ~Command() {}
 
@@ -24,6 +29,11 @@ public:
 
     virtual void run(Application &app, int argc, const wchar_t **argv) = 0;
 
+    /// A re-entrant command can run on a worker thread, concurrently with other re-entrant commands
+    /// (see BatchExecutor). Its run() must not change the console stack or any other shared state,
+    /// and should print with Application::out() or out_printf()/err_printf() so that its output is kept in order.
+    virtual bool is_reentrant() const { return false; }
+
     // Exapmle:
     // If command name is "show"
     // and user input is "show xyz abcdef"
@@ -42,9 +52,31 @@ public:
     {
         return std::vector<CompletionItem>();
     }
+
+    /// Complete like auto_complete(), but give the candidates to \a sink one by one, so that a completer over
+    /// a huge number of candidates need not make a vector of them. The terminal completes with this method.
+    /// The default implementation adds the result of auto_complete().
+    virtual void stream_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor,
+                                 CompletionSink &sink)
+    {
+        std::wstring completion;
+        std::vector<CompletionItem> candidates = auto_complete(app, line, len, cursor, completion);
+        for (auto &candidate : candidates) {
+            sink.add(std::move(candidate));
+        }
+        sink.set_completion(completion);
+    }
+
+    /// Return true if auto_complete() matches candidates by the prefix of the token at the cursor, so that
+    /// the candidates for a longer prefix are those of a shorter one which start with the longer prefix.
+    /// The console can then narrow the last candidates, see Console::auto_complete().
+    virtual bool is_completion_narrowable() const { return false; }
 private:
+    friend class CommandStats;
+
     std::wstring name_;
     std::wstring usage_;
+    mutable std::atomic<CommandStatsEntry *> stats_entry_; // cached by CommandStats::entry()
 };
 
 } // namespace exole
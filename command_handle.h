@@ -0,0 +1,40 @@
+#ifndef EXOLE_COMMAND_HANDLE_H
+#define EXOLE_COMMAND_HANDLE_H
+
+namespace exole {
+
+class Application;
+class Command;
+
+enum CommandStatus
+{
+    CS_OK = 0,
+    CS_NOT_FOUND,       // a name in the command path is not found
+    CS_NOT_A_CONSOLE,   // a name before the last one in the command path is not a console
+    CS_INVALID_HANDLE,  // the handle has not been resolved
+};
+
+/// A command resolved once by Application::resolve_command(), which can then be run many times with
+/// Application::invoke(), without tokenizing or looking up the command again.
+/// A handle stays valid as long as the application, since commands are never removed.
+class CommandHandle
+{
+public:
+    CommandHandle()
+    : command_(nullptr)
+    {}
+
+    bool valid() const { return command_ != nullptr; }
+    Command *command() const { return command_; }
+private:
+    friend class Application;
+    explicit CommandHandle(Command *command)
+    : command_(command)
+    {}
+
+    Command *command_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_COMMAND_HANDLE_H
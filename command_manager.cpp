@@ -1,11 +1,17 @@
 #include "command_manager.h"
-#include "wcs_util.h"
-#include <cstring>
-#include <cassert>
-#include <limits>
+#include "detail/command_table.h"
+#include "detail/command_trie.h"
+#include "detail/completion_session.h"
+#include <cwchar>
 
 namespace exole {
 
+CommandManager::CommandManager()
+: table_(new detail::CommandTable())
+, index_(new detail::CommandTrie())
+{
+}
+
 CommandManager::~CommandManager()
 {
     for (auto c : commands_) {
@@ -15,24 +21,36 @@ CommandManager::~CommandManager()
 
 bool CommandManager::add_command(Command *command)
 {
-    auto result = command_map_.insert(std::make_pair(command->name(), command));
-    if (!result.second) {
+    if (!table_->insert(command)) {
         // TODO: log
         return false;
     }
+    index_->insert(command->name(), command);
     commands_.push_back(command);
+    detail::CompletionSession::invalidate_all();
     return true;
 }
 
-Command *CommandManager::find_command(const std::wstring &name)
+Command *CommandManager::find_command(const std::wstring &name) const
+{
+    return table_->find(name.data(), name.size());
+}
+
+Command *CommandManager::find_command(const wchar_t *name) const
+{
+    return table_->find(name, wcslen(name));
+}
+
+Command *CommandManager::find_command(const wchar_t *name, size_t len) const
 {
-    auto it = command_map_.find(name);
-    return it == command_map_.end() ? nullptr : it->second;
+    return table_->find(name, len);
 }
 
 std::vector<Command *> CommandManager::match_by_prefix(const std::wstring &prefix, std::wstring &completion) const
 {
-    return exole::match_by_prefix(commands_, [](Command *cmd) { return cmd->name(); }, prefix, completion);
+    std::vector<Command *> result;
+    index_->match_by_prefix(prefix.data(), prefix.size(), result, completion);
+    return result;
 }
 
 } // namespace exole
@@ -2,29 +2,40 @@
 #define EXOLE_COMMAND_MANAGER_H
 
 #include "command.h"
-#include <map>
+#include <memory>
 #include <vector>
 
 namespace exole {
 
+namespace detail {
+class CommandTable;
+class CommandTrie;
+}
+
 class CommandManager
 {
 public:
-    typedef std::map<std::wstring, Command *> CommandMap;
     typedef std::vector<Command *> CommandVector;
 
+    CommandManager();
     ~CommandManager();
 
     bool add_command(Command *command);
 
-    Command *find_command(const std::wstring &name);
+    /// Find a command by name. These overloads do not allocate.
+    Command *find_command(const std::wstring &name) const;
+    Command *find_command(const wchar_t *name) const;
+    Command *find_command(const wchar_t *name, size_t len) const;
 
+    /// \return the commands whose names start with \a prefix, in lexicographical order of names.
     std::vector<Command *> match_by_prefix(const std::wstring &prefix, std::wstring &completion) const;
 
+    /// \return all commands in the order they were added.
     const CommandVector &get_commands() const { return commands_; }
 
 private:
-    CommandMap command_map_;
+    std::unique_ptr<detail::CommandTable> table_; // for lookup
+    std::unique_ptr<detail::CommandTrie> index_;  // for prefix matching
     CommandVector commands_;
 };
 
@@ -0,0 +1,176 @@
+#include "command_stats.h"
+#include "command.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+namespace exole {
+
+LatencyHistogram::LatencyHistogram()
+: count_(0)
+, max_(0)
+{
+    for (auto &b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &b : buckets_) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucket_index(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return value;
+    int e = 63 - __builtin_clzll(value); // e >= SUB_BUCKET_BITS
+    int sub = (value >> (e - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (e - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets_[bucket_index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t old_max = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > old_max && !max_.compare_exchange_weak(old_max, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+    uint64_t rank = uint64_t(p / 100.0 * total + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucket_upper_bound(i), max());
+    }
+    return max();
+}
+
+CommandStats::~CommandStats()
+{
+    // the commands may outlive the stats
+    for (const auto &e : entries_) {
+        e.first->stats_entry_.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+CommandStats::Entry *CommandStats::entry(const Command *parent, const Command *command)
+{
+    Entry *cached = command->stats_entry_.load(std::memory_order_acquire);
+    if (cached && cached->stats == this) {
+        return cached;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &entry = entries_[command];
+    if (!entry) {
+        entry.reset(new Entry);
+        entry->stats = this;
+        auto it = parent ? entries_.find(parent) : entries_.end();
+        if (it != entries_.end() && it->second) {
+            entry->path = it->second->path + L' ';
+        }
+        else if (parent && !parent->name().empty()) { // the parent was entered without being dispatched
+            entry->path = parent->name() + L' ';
+        }
+        entry->path += command->name().empty() ? L"<root>" : command->name();
+    }
+    command->stats_entry_.store(entry.get(), std::memory_order_release);
+    return entry.get();
+}
+
+static std::string format_duration(uint64_t ns)
+{
+    char buf[32];
+    if (ns < 1000)
+        snprintf(buf, sizeof(buf), "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000)
+        snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(buf, sizeof(buf), "%.1fms", ns / 1e6);
+    else
+        snprintf(buf, sizeof(buf), "%.2fs", ns / 1e9);
+    return buf;
+}
+
+static void print_line(Output &out, Output::Stream stream, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void print_line(Output &out, Output::Stream stream, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    out.vprintf(stream, format, args);
+    va_end(args);
+}
+
+static void print_histogram(Output &out, Output::Stream stream, const char *kind, const LatencyHistogram &h)
+{
+    print_line(out, stream, "  %-8s %10llu %10s %10s %10s\n", kind, (unsigned long long)h.count(),
+            format_duration(h.percentile(50)).c_str(),
+            format_duration(h.percentile(99)).c_str(),
+            format_duration(h.max()).c_str());
+}
+
+void CommandStats::print(Output &out, Output::Stream stream) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const Entry *> entries;
+    entries.reserve(entries_.size());
+    for (const auto &e : entries_) {
+        entries.push_back(e.second.get());
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry *a, const Entry *b) { return a->path < b->path; });
+
+    print_line(out, stream, "  %-8s %10s %10s %10s %10s\n", "", "calls", "p50", "p99", "max");
+    for (const Entry *e : entries) {
+        print_line(out, stream, "%ls\n", e->path.c_str());
+        if (e->run.count() > 0)
+            print_histogram(out, stream, "run", e->run);
+        if (e->complete.count() > 0)
+            print_histogram(out, stream, "complete", e->complete);
+    }
+}
+
+void CommandStats::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &e : entries_) {
+        e.second->run.reset();
+        e.second->complete.reset();
+    }
+}
+
+bool CommandStats::enabled()
+{
+#ifdef EXOLE_ENABLE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace exole
@@ -0,0 +1,92 @@
+#ifndef EXOLE_COMMAND_STATS_H
+#define EXOLE_COMMAND_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include "output.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace exole {
+
+class Command;
+
+/// A latency histogram in the style of HdrHistogram: each power of 2 is divided into 16 linear sub-buckets,
+/// so a recorded value is reported with a relative error under 1/16.
+/// Recording is lock-free and can be done from several threads.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds);
+    /// Forget the recorded values. Values recorded meanwhile by other threads may be partly kept.
+    void reset();
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    /// \param p percentile in [0, 100]
+    /// \return the highest value equivalent to the percentile.
+    uint64_t percentile(double p) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static int bucket_index(uint64_t value);
+    static uint64_t bucket_upper_bound(int index);
+
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+};
+
+class CommandStats;
+
+struct CommandStatsEntry
+{
+    const CommandStats *stats; // the owner
+    std::wstring path; // e.g. L"hex next"
+    LatencyHistogram run;
+    LatencyHistogram complete;
+};
+
+/**
+ * CommandStats records how many times each command runs or completes, and how long it takes.
+ * It is filled by Console when the library is built with EXOLE_ENABLE_STATS, and printed by StatsCommand.
+ */
+class CommandStats
+{
+public:
+    typedef CommandStatsEntry Entry;
+
+    CommandStats() {}
+    ~CommandStats();
+
+    /// Get the entry of \a command, creating it if necessary. The entry is cached in the command, so that only
+    /// the first call for a command takes the lock, and dispatching on several threads does not contend.
+    /// \param parent the console that dispatches to \a command, nullptr if there is none.
+    /// \note The returned entry stays valid as long as the CommandStats.
+    Entry *entry(const Command *parent, const Command *command);
+
+    /// Print p50/p99/max of every command, sorted by command path.
+    void print(Output &out, Output::Stream stream = Output::OUT) const;
+
+    /// Reset the histograms of every entry. The entries stay valid, since timers may be recording into them,
+    /// e.g. the one of "stats clear" itself.
+    void clear();
+
+    /// Whether the library is built with EXOLE_ENABLE_STATS.
+    static bool enabled();
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<const Command *, std::unique_ptr<Entry>> entries_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_COMMAND_STATS_H
@@ -2,6 +2,7 @@
 #define EXOLE_COMPLETION_H
 
 #include <string>
+#include <utility>
 
 namespace exole {
 
@@ -11,12 +12,29 @@ class BasicCompletionItem
 public:
     BasicCompletionItem(const String &value, bool is_complete)
     : value_(value)
+    , borrowed_(nullptr)
     , is_complete_(is_complete)
     {}
-    const String &value() const { return value_; }
+    BasicCompletionItem(String &&value, bool is_complete)
+    : value_(std::move(value))
+    , borrowed_(nullptr)
+    , is_complete_(is_complete)
+    {}
+
+    /// Make an item which refers to \a value rather than copying it, e.g. for thousands of command names.
+    /// \a value must outlive the item and its copies, and must not change meanwhile.
+    static BasicCompletionItem borrow(const String &value, bool is_complete)
+    {
+        BasicCompletionItem item(String(), is_complete);
+        item.borrowed_ = &value;
+        return item;
+    }
+
+    const String &value() const { return borrowed_ ? *borrowed_ : value_; }
     bool is_complete() const { return is_complete_; }
 private:
     String value_;
+    const String *borrowed_; // the value if not null
     bool is_complete_;
 
 };
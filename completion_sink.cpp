@@ -0,0 +1,91 @@
+#include "completion_sink.h"
+#include <algorithm>
+
+namespace exole {
+
+CompletionSink::CompletionSink(size_t limit)
+: mutex_(nullptr)
+, limit_(limit)
+, count_(0)
+, stopped_(false)
+, has_completion_(false)
+{
+}
+
+void CompletionSink::set_prefix(const std::wstring &prefix)
+{
+    prefix_ = prefix;
+}
+
+bool CompletionSink::count_candidate(const std::wstring &value)
+{
+    if (count_ == 0) {
+        common_ = value;
+    }
+    else if (common_.size() > prefix_.size()) { // no shorter than the prefix, if candidates start with it
+        size_t n = std::min(common_.size(), value.size());
+        size_t i = 0;
+        while (i < n && common_[i] == value[i])
+            i++;
+        common_.resize(i);
+    }
+    count_++;
+    return items_.size() < limit_;
+}
+
+bool CompletionSink::add(const std::wstring &value, bool is_complete)
+{
+    if (count_candidate(value)) {
+        std::unique_lock<std::mutex> lock;
+        if (mutex_)
+            lock = std::unique_lock<std::mutex>(*mutex_);
+        items_.push_back(CompletionItem(value, is_complete));
+        return true;
+    }
+    return common_.size() > prefix_.size();
+}
+
+bool CompletionSink::add(CompletionItem item)
+{
+    if (count_candidate(item.value())) {
+        std::unique_lock<std::mutex> lock;
+        if (mutex_)
+            lock = std::unique_lock<std::mutex>(*mutex_);
+        items_.push_back(std::move(item));
+        return true;
+    }
+    return common_.size() > prefix_.size();
+}
+
+void CompletionSink::set_completion(const std::wstring &completion)
+{
+    completion_ = completion;
+    has_completion_ = true;
+}
+
+std::wstring CompletionSink::completion() const
+{
+    if (has_completion_) {
+        return completion_;
+    }
+    if (count_ == 0 || common_.size() < prefix_.size()) {
+        return std::wstring();
+    }
+    return common_.substr(prefix_.size());
+}
+
+void CompletionSink::clear()
+{
+    std::unique_lock<std::mutex> lock;
+    if (mutex_)
+        lock = std::unique_lock<std::mutex>(*mutex_);
+    items_.clear();
+    prefix_.clear();
+    common_.clear();
+    completion_.clear();
+    count_ = 0;
+    stopped_ = false;
+    has_completion_ = false;
+}
+
+} // namespace exole
@@ -0,0 +1,73 @@
+#ifndef EXOLE_COMPLETION_SINK_H
+#define EXOLE_COMPLETION_SINK_H
+
+#include "completion.h"
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace exole {
+
+/**
+ * CompletionSink receives completion candidates one by one, see Command::stream_complete().
+ * It keeps only the first candidates up to a limit, for display, and counts the rest. The completion,
+ * i.e. the common prefix of all candidates after the prefix being completed, is computed as they come.
+ * So a completer over millions of candidates need not make a vector of them.
+ */
+class CompletionSink
+{
+public:
+    /// \param limit the number of candidates to keep.
+    explicit CompletionSink(size_t limit = static_cast<size_t>(-1));
+
+    /// Set the prefix which the candidates are matched by, before adding them. Empty by default, but
+    /// Console::stream_complete() sets it to the token at the cursor before calling a sub-command.
+    void set_prefix(const std::wstring &prefix);
+
+    /// Add a candidate, which should start with the prefix. The value is copied only if the candidate is kept.
+    /// \return false if more candidates would change nothing but count(), so the completer may stop
+    /// (call stop() then).
+    bool add(const std::wstring &value, bool is_complete);
+    /// Add a candidate, which is moved in if kept. A borrowed value (see CompletionItem::borrow()) stays borrowed.
+    bool add(CompletionItem item);
+    /// Tell that the completer has stopped before adding all candidates, so count() is a lower bound.
+    void stop() { stopped_ = true; }
+    /// Override the completion computed from the candidates, e.g. by a completer which returns a vector.
+    void set_completion(const std::wstring &completion);
+
+    /// The number of candidates added.
+    size_t count() const { return count_; }
+    bool stopped() const { return stopped_; }
+    size_t limit() const { return limit_; }
+    /// The first candidates, no more than limit().
+    const std::vector<CompletionItem> &items() const { return items_; }
+    std::vector<CompletionItem> &items() { return items_; }
+    std::wstring completion() const;
+
+    /// Forget the candidates, but keep the limit.
+    void clear();
+
+    /// Lock \a mutex while changing items(), so that another thread can copy the candidates kept so far,
+    /// e.g. when a completer on a helper thread passes its deadline. nullptr for none, the default.
+    void set_mutex(std::mutex *mutex) { mutex_ = mutex; }
+
+private:
+    /// Count a candidate, and update the common prefix.
+    /// \return true if the candidate should be kept.
+    bool count_candidate(const std::wstring &value);
+
+    std::vector<CompletionItem> items_;
+    std::wstring prefix_;
+    std::wstring common_;     // common prefix of all candidates
+    std::wstring completion_; // set by set_completion()
+    std::mutex *mutex_;       // guards items_ if not null
+    size_t limit_;
+    size_t count_;
+    bool stopped_;
+    bool has_completion_;
+};
+
+} // namespace exole
+
+#endif // EXOLE_COMPLETION_SINK_H
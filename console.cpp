@@ -3,6 +3,9 @@
 #include "token_parser.h"
 #include "wcs_util.h"
 #include "detail/arguments.h"
+#include "detail/completion_session.h"
+#include "detail/session.h"
+#include "detail/stats_timer.h"
 #include <cassert>
 
 namespace exole {
@@ -11,13 +14,41 @@ using detail::Arguments;
 
 Console::Console(std::wstring name)
 : Command(name)
-, last_arguments_(nullptr)
+, commands_built_(true)
+, completion_session_(new detail::CompletionSession())
+, parser_(new TokenParser())
 , repeat_on_empty_(true)
 {}
 
 Console::~Console()
 {
-    delete last_arguments_;
+    delete completion_session_;
+    delete parser_;
+}
+
+CommandManager &Console::command_manager()
+{
+    if (!commands_built_.load(std::memory_order_acquire)) {
+        build_commands();
+    }
+    return command_manager_;
+}
+
+void Console::set_command_factory(std::function<void(CommandManager &)> factory)
+{
+    std::lock_guard<std::mutex> lock(factory_mutex_);
+    command_factory_ = std::move(factory);
+    commands_built_ = !command_factory_;
+}
+
+void Console::build_commands()
+{
+    std::lock_guard<std::mutex> lock(factory_mutex_);
+    if (command_factory_) {
+        command_factory_(command_manager_);
+        command_factory_ = nullptr;
+    }
+    commands_built_.store(true, std::memory_order_release);
 }
 
 void Console::run(Application &app, int argc, const wchar_t **argv)
@@ -29,28 +60,29 @@ void Console::run(Application &app, int argc, const wchar_t **argv)
             on_enter_console(app);
         }
         else if (repeat_on_empty_) {
-            // repeat last command
-            if (last_arguments_ && last_arguments_->argc() > 0) {
-                last_arguments_->freeze();
-                run(app, last_arguments_->argc(), last_arguments_->argv());
-                last_arguments_->unfreeze();
+            // repeat last command of the session, e.g. not one entered by another client of the server
+            auto &saved = app.session().last_arguments;
+            auto it = saved.find(this);
+            if (it != saved.end() && it->second.argc() > 0) {
+                Arguments &last_arguments = it->second;
+                last_arguments.freeze();
+                run(app, last_arguments.argc(), last_arguments.argv());
+                last_arguments.unfreeze();
             }
         }
     }
     else if (argc > 0) {
+        detail::CompletionSession::invalidate_all(); // the command may change the candidates
         if (repeat_on_empty_) {
             // save args as last command
-            if (last_arguments_ == nullptr) {
-                last_arguments_ = new Arguments();
-            }
-            last_arguments_->set(argc, argv);
+            app.session().last_arguments[this].set(argc, argv);
         }
 
         // check if argv[0] is a subcommand/subconsole
-        std::wstring cmd = argv[0];
-        Command *command = command_manager().find_command(cmd);
+        Command *command = command_manager().find_command(argv[0]);
         if (command) {
             // argv[0] is a subcommand/subconsole
+            EXOLE_STATS_TIME(app.stats().entry(this, command)->run);
             command->run(app, argc-1, argv+1);
         }
         else {
@@ -63,8 +95,67 @@ void Console::run(Application &app, int argc, const wchar_t **argv)
 std::vector<CompletionItem> Console::auto_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor, std::wstring &completion)
 {
     completion.clear();
-    TokenParser parser;
-    parser.parse(line, len, cursor);
+    // Sub-commands which parse their arguments take the tokens from here.
+    parser_->reparse(line, len, cursor);
+    const TokenParser &parser = *parser_;
+    const TokenParser *old_shared = TokenParser::set_shared(parser_);
+    const auto &cursor_info = parser.get_cursor_info();
+
+    // If only the token at the cursor has been extended since the last completion, narrow its candidates.
+    const wchar_t *token_begin = cursor;
+    if (cursor_info.token_index < parser.tokens().size()
+            && parser.tokens()[cursor_info.token_index].original_begin() <= cursor) {
+        token_begin = parser.tokens()[cursor_info.token_index].original_begin();
+    }
+    std::wstring head(line, token_begin);
+    std::wstring tail(cursor, line + len);
+    std::vector<CompletionItem> result;
+    if (completion_session_->narrow(head, tail, cursor_info.token_index, cursor_info.prefix, result, completion)) {
+        TokenParser::set_shared(old_shared);
+        return result;
+    }
+
+    bool narrowable = false;
+    uint64_t generation = detail::CompletionSession::generation();
+    result = complete_tokens(app, parser, line, len, cursor, completion, narrowable);
+    if (narrowable && !Application::completion_cancelled()) {
+        completion_session_->save(head, tail, cursor_info.token_index, cursor_info.prefix, result, generation);
+    }
+    else {
+        completion_session_->clear();
+    }
+    TokenParser::set_shared(old_shared);
+    return result;
+}
+
+void Console::stream_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor, CompletionSink &sink)
+{
+    parser_->reparse(line, len, cursor);
+    const TokenParser &parser = *parser_;
+    const TokenParser *old_shared = TokenParser::set_shared(parser_);
+    // Candidates are usually matched by the token at the cursor, so the completion is what follows it.
+    // A completer matching by another prefix sets its own.
+    sink.set_prefix(parser.get_cursor_info().prefix);
+    if (parser.get_cursor_info().token_index > 0) {
+        const Token &token0 = parser.tokens()[0];
+        Command *cmd = command_manager().find_command(token0.value_data(), token0.value_size());
+        if (cmd && !cmd->is_completion_narrowable()) {
+            completion_session_->clear();
+            const wchar_t *subline = token0.original_end() + 1;
+            size_t sublen = (line + len) - (token0.original_end() + 1);
+            EXOLE_STATS_TIME(app.stats().entry(this, cmd)->complete);
+            cmd->stream_complete(app, subline, sublen, cursor, sink);
+            TokenParser::set_shared(old_shared);
+            return;
+        }
+    }
+    Command::stream_complete(app, line, len, cursor, sink);
+    TokenParser::set_shared(old_shared);
+}
+
+std::vector<CompletionItem> Console::complete_tokens(Application &app, const TokenParser &parser,
+        const wchar_t *line, size_t len, const wchar_t *cursor, std::wstring &completion, bool &narrowable)
+{
     const auto &cursor_info = parser.get_cursor_info();
 
     // 1. if cursor is at the first token: 
@@ -79,26 +170,32 @@ std::vector<CompletionItem> Console::auto_complete(Application &app, const wchar
             std::vector<CompletionItem> result;
             result.reserve(commands.size());
             for (auto c : commands) {
-                result.push_back(CompletionItem(c->name(), true));
+                result.push_back(CompletionItem::borrow(c->name(), true));
             }
+            narrowable = true;
             return result;
         }
         else { // cannot match any sub-commands, try custom_complete()
+            narrowable = is_completion_narrowable();
             return custom_complete(app, line, len, cursor, completion);
         }
     }
     else { // 2. if the cursor is after the first token, and the first token is a sub command
         const Token &token0 = parser.tokens()[0];
-        Command *cmd = command_manager().find_command(token0.value());
+        Command *cmd = command_manager().find_command(token0.value_data(), token0.value_size());
         if (cmd) {
             // pass sub arguments to the sub command
             const wchar_t *subline = token0.original_end() + 1;
             size_t sublen = (line + len) - (token0.original_end() + 1);
+            // a sub-console narrows its own candidates
+            narrowable = !dynamic_cast<Console *>(cmd) && cmd->is_completion_narrowable();
+            EXOLE_STATS_TIME(app.stats().entry(this, cmd)->complete);
             return cmd->auto_complete(app, subline, sublen, cursor, completion);
         }
     }
 
     // 3. fallback to custom_complete()
+    narrowable = is_completion_narrowable();
     return custom_complete(app, line, len, cursor, completion);
 }
 
@@ -108,16 +205,17 @@ std::vector<CompletionItem> Console::custom_complete(Application &, const wchar_
     return std::vector<CompletionItem>();
 }
 
-void Console::custom_run(Application &, int argc, const wchar_t **argv)
+void Console::custom_run(Application &app, int argc, const wchar_t **argv)
 {
     // the default implementation cannot handle any args
-    fprintf(stderr, "Unknown command: \"");
+    Output &out = app.out();
+    out.eprintf("Unknown command: \"");
     for (int i = 0; i < argc; i++) {
         if (i > 0)
-            fprintf(stderr, " ");
-        fprintf(stderr, "%ls", argv[i]);
+            out.put(Output::ERR, ' ');
+        out.eprintf("%ls", argv[i]);
     }
-    fprintf(stderr, "\"\n");
+    out.eprintf("\"\n");
 }
 
 void Console::on_enter_console(Application &app)
@@ -138,31 +236,30 @@ void Console::set_repeat_on_empty(bool enabled)
 
 void Console::show_help(Application &app)
 {
+    Output &out = app.out();
     if (!command_manager().get_commands().empty()) {
-        printf("Commands:\n");
+        out.printf("Commands:\n");
         for (size_t i = 0; i < command_manager().get_commands().size(); i++) {
             Command *command = command_manager().get_commands()[i];
             if (!command->usage().empty())
-                printf("  %ls", command->usage().c_str());
+                out.printf("  %ls\n", command->usage().c_str());
             else
-                printf("  %ls", command->name().c_str());
-            printf("\n");
+                out.printf("  %ls\n", command->name().c_str());
         }
     }
     if (!app.is_batch_mode())
-        printf("  <Ctrl-D>: quit\n");
+        out.printf("  <Ctrl-D>: quit\n");
 }
 
-bool Console::show_command_help(Application & /*app*/, const std::wstring &command)
+bool Console::show_command_help(Application &app, const std::wstring &command)
 {
     Command *cmd = command_manager().find_command(command);
     if (cmd == nullptr)
         return false;
     if (!cmd->usage().empty())
-        printf("  %ls", cmd->usage().c_str());
+        app.out().printf("  %ls\n", cmd->usage().c_str());
     else
-        printf("  %ls", cmd->name().c_str());
-    printf("\n");
+        app.out().printf("  %ls\n", cmd->name().c_str());
     return true;
 }
 
@@ -4,22 +4,40 @@
 #include "command.h"
 #include "command_context.h"
 #include "command_manager.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
 
 namespace exole {
 
 class Application;
 
-namespace detail { class Arguments; }
+class TokenParser;
+
+namespace detail {
+class CompletionSession;
+}
 
 class Console : public Command
 {
 public:
     Console(std::wstring name);
     ~Console();
-    CommandManager &command_manager() { return command_manager_; }
+    CommandManager &command_manager();
+
+    /// Add the sub-commands with \a factory on the first call to command_manager(), e.g. when the console is
+    /// entered, completed or shown in help, rather than in the constructor. A console with many commands
+    /// then does not slow down startup until it is used.
+    void set_command_factory(std::function<void(CommandManager &)> factory);
     void run(Application &app, int argc, const wchar_t **argv) override;
 
+    /// When the user extends the token at the cursor and completes again, the last candidates are narrowed
+    /// rather than computed again, if they come from sub-command names or from a command which opts in
+    /// with is_completion_narrowable(). For custom_complete(), override is_completion_narrowable() of the console.
     std::vector<CompletionItem> auto_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor, std::wstring &completion) override;
+    /// Let a sub-command which cannot be narrowed stream its candidates, otherwise add those of auto_complete().
+    /// The prefix of the sink is set to the token at the cursor, up to the cursor, before.
+    void stream_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor, CompletionSink &sink) override;
 
     virtual std::wstring get_prompt(Application &app);
 
@@ -35,8 +53,18 @@ protected:
 
     virtual void custom_run(Application &app, int argc, const wchar_t **argv);
 private:
+    void build_commands();
+    /// Complete without the candidates of the last completion.
+    /// \param narrowable set to true if the result can be narrowed, see auto_complete().
+    std::vector<CompletionItem> complete_tokens(Application &app, const TokenParser &parser, const wchar_t *line, size_t len,
+                                                const wchar_t *cursor, std::wstring &completion, bool &narrowable);
+
     CommandManager command_manager_;
-    detail::Arguments *last_arguments_;
+    std::function<void(CommandManager &)> command_factory_;
+    std::atomic<bool> commands_built_; // command_factory_ has been run
+    std::mutex factory_mutex_;
+    detail::CompletionSession *completion_session_;
+    TokenParser *parser_; // tokens of the line last completed, see TokenParser::reparse()
     bool repeat_on_empty_;
 };
 
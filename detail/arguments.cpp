@@ -1,45 +1,34 @@
 #include "arguments.h"
-#include <cstdlib>
-#include <cstring>
-#include <string>
+#include <cwchar>
 
 namespace exole {
 namespace detail {
 
 Arguments::Arguments()
 : argc_(0)
-, argv_(nullptr)
 , frozen_(false)
 {}
 
-Arguments::~Arguments()
-{
-    clear();
-}
-
-void Arguments::clear()
-{
-    for (int i = 0; i < argc_; i++) {
-        ::free(argv_[i]);
-    }
-    delete [] argv_;
-    argv_ = nullptr;
-    argc_ = 0;
-}
-
 void Arguments::set(int argc, const wchar_t **argv)
 {
     if (frozen_)
         return;
     if (argc < 0) // invalid argument
         return;
-    clear();
+    argc_ = argc;
+    buffer_.clear();
+    argv_.clear();
     if (argc == 0)
         return;
-    argc_ = argc;
-    argv_ = new wchar_t *[argc_];
+
+    size_t total = 0;
+    for (int i = 0; i < argc; i++) {
+        total += wcslen(argv[i]) + 1;
+    }
+    buffer_.reserve(total); // buffer_ will not be reallocated below, so the pointers stay valid
     for (int i = 0; i < argc; i++) {
-        argv_[i] = wcsdup(argv[i]);
+        argv_.push_back(buffer_.data() + buffer_.size());
+        buffer_.insert(buffer_.end(), argv[i], argv[i] + wcslen(argv[i]) + 1);
     }
 }
 
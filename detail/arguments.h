@@ -1,25 +1,28 @@
 #ifndef EXOLE_ARGUMENTS_H
 #define EXOLE_ARGUMENTS_H
 
+#include <cstddef>
+#include <vector>
+
 namespace exole {
 namespace detail {
 
 class Arguments {
 public:
     int argc() const { return argc_; }
-    const wchar_t **argv() const { return (const wchar_t **)argv_; }
+    const wchar_t **argv() const { return const_cast<const wchar_t **>(argv_.data()); }
 
+    /// Copy the arguments. The buffers are reused, so this does not allocate once they are large enough.
     void set(int argc, const wchar_t **argv);
 
     void freeze() { frozen_ = true; }
     void unfreeze() { frozen_ = false; }
 
     Arguments();
-    ~Arguments();
 private:
-    void clear();
     int argc_;
-    wchar_t **argv_;
+    std::vector<wchar_t> buffer_;   // null-terminated arguments
+    std::vector<const wchar_t *> argv_;
     bool frozen_;
 };
 
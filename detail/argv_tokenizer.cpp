@@ -0,0 +1,154 @@
+#include "argv_tokenizer.h"
+#include <cwchar>
+#include <cwctype>
+
+namespace exole {
+namespace detail {
+
+ArgvTokenizer::ArgvTokenizer()
+: argc_(0)
+, quote_(Q_NONE)
+, in_token_(false)
+, token_quoted_(false)
+, last_token_quoted_(false)
+, continued_(false)
+, status_(OK)
+{
+    argv_.push_back(nullptr);
+}
+
+void ArgvTokenizer::end_token()
+{
+    buffer_.push_back(L'\0');
+    in_token_ = false;
+    last_token_quoted_ = token_quoted_;
+}
+
+void ArgvTokenizer::reset()
+{
+    // clear() keeps the capacity
+    buffer_.clear();
+    offsets_.clear();
+    argv_.clear();
+    argv_.push_back(nullptr);
+    argc_ = 0;
+    quote_ = Q_NONE;
+    in_token_ = false;
+    token_quoted_ = false;
+    last_token_quoted_ = false;
+    continued_ = false;
+    status_ = OK;
+}
+
+bool ArgvTokenizer::is_background() const
+{
+    return argc_ > 0 && !last_token_quoted_ && 0 == wcscmp(argv_[argc_ - 1], L"&");
+}
+
+const char *ArgvTokenizer::status_message(Status status)
+{
+    switch (status) {
+    case OK: return "successful";
+    case UNMATCHED_SQUOTE: return "unmatched single quote";
+    case UNMATCHED_DQUOTE: return "unmatched double quote";
+    case BACKSLASH_QUOTED: return "backslash quoted";
+    }
+    return "unknown error";
+}
+
+ArgvTokenizer::Status ArgvTokenizer::tokenize(const wchar_t *line, size_t len)
+{
+    reset();
+    return feed(line, len);
+}
+
+ArgvTokenizer::Status ArgvTokenizer::feed(const wchar_t *line, size_t len)
+{
+    if (status_ == OK) {
+        reset();
+    }
+
+    // The state chart is the same as Token::push(), except for newlines.
+    for (const wchar_t *p = line, *end = line + len; p < end; p++) {
+        const wchar_t c = *p;
+        continued_ = false;
+        if (!in_token_) {
+            if (iswspace(c))
+                continue;
+            offsets_.push_back(buffer_.size());
+            in_token_ = true;
+            token_quoted_ = false;
+        }
+        switch (quote_) {
+        case Q_NONE:
+            if (iswspace(c)) {
+                end_token();
+                break;
+            }
+            switch (c) {
+            case L'\\': quote_ = Q_ESCAPE; token_quoted_ = true; break;
+            case L'"': quote_ = Q_DQUOTE; token_quoted_ = true; break;
+            case L'\'': quote_ = Q_SQUOTE; token_quoted_ = true; break;
+            default: buffer_.push_back(c); break;
+            }
+            break;
+        case Q_DQUOTE:
+            switch (c) {
+            case L'"': quote_ = Q_NONE; break;
+            case L'\\': quote_ = Q_QESCAPE; break;
+            default: buffer_.push_back(c); break;
+            }
+            break;
+        case Q_SQUOTE:
+            if (c == L'\'')
+                quote_ = Q_NONE;
+            else
+                buffer_.push_back(c);
+            break;
+        case Q_ESCAPE:
+            quote_ = Q_NONE;
+            if (c == L'\n') { // line continuation
+                continued_ = true;
+                if (offsets_.back() == buffer_.size()) { // the backslash started the token
+                    offsets_.pop_back();
+                    in_token_ = false;
+                }
+                break;
+            }
+            buffer_.push_back(c);
+            break;
+        case Q_QESCAPE:
+            quote_ = Q_DQUOTE;
+            if (c == L'\n') { // line continuation
+                continued_ = true;
+                break;
+            }
+            buffer_.push_back(c);
+            break;
+        }
+    }
+
+    switch (quote_) {
+    case Q_NONE: status_ = continued_ ? BACKSLASH_QUOTED : OK; break;
+    case Q_SQUOTE: status_ = UNMATCHED_SQUOTE; break;
+    case Q_DQUOTE: status_ = UNMATCHED_DQUOTE; break;
+    case Q_ESCAPE:
+    case Q_QESCAPE: status_ = BACKSLASH_QUOTED; break;
+    }
+    if (status_ != OK)
+        return status_;
+    if (in_token_)
+        end_token();
+
+    // buffer_ does not grow any more, so the pointers stay valid
+    argv_.clear();
+    argc_ = offsets_.size();
+    for (size_t offset : offsets_) {
+        argv_.push_back(buffer_.data() + offset);
+    }
+    argv_.push_back(nullptr);
+    return OK;
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,78 @@
+#ifndef EXOLE_ARGV_TOKENIZER_H
+#define EXOLE_ARGV_TOKENIZER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+/// Splits a command line into argc/argv with the same quoting rules as TokenParser.
+/// The arguments are stored in buffers owned by the tokenizer, which keep their capacity between commands,
+/// so tokenizing a command does not allocate once the buffers are large enough.
+///
+/// A command can span several lines: a newline in quotes is part of the argument, and a backslash
+/// before a newline continues the command on the next line. feed() keeps the state of an incomplete
+/// command, and only scans the new input, so a long multi-line argument is tokenized in linear time.
+class ArgvTokenizer {
+public:
+    /// Same values as the return value of libedit's tok_wstr().
+    enum Status {
+        OK = 0,
+        UNMATCHED_SQUOTE = 1,
+        UNMATCHED_DQUOTE = 2,
+        BACKSLASH_QUOTED = 3,
+    };
+
+    ArgvTokenizer();
+
+    /// Tokenize a line. The previous result, or an incomplete command, is discarded.
+    Status tokenize(const wchar_t *line, size_t len);
+
+    /// Tokenize more input of an incomplete command, or a new command if the last one is complete.
+    /// \return OK if the command is complete, otherwise the command is kept for the next call.
+    Status feed(const wchar_t *line, size_t len);
+
+    /// \return OK, or why the last input ended with an incomplete command.
+    Status status() const { return status_; }
+    bool incomplete() const { return status_ != OK; }
+    static const char *status_message(Status status);
+
+    /// Discard an incomplete command.
+    void reset();
+
+    /// The result of the last successful tokenize() or feed(). argv()[argc()] is nullptr.
+    /// \note argv() is invalidated by the next call to tokenize() or feed().
+    int argc() const { return argc_; }
+    const wchar_t **argv() { return argv_.data(); }
+    /// Whether the last argument of the result is an unquoted "&", i.e. the command runs in the background.
+    /// A quoted or escaped one, e.g. "&", is an ordinary argument.
+    bool is_background() const;
+
+private:
+    enum Quote {
+        Q_NONE,
+        Q_SQUOTE,
+        Q_DQUOTE,
+        Q_ESCAPE,   // escape outside quotes
+        Q_QESCAPE,  // escape in double quotes
+    };
+
+    void end_token();
+
+    std::vector<wchar_t> buffer_;      // null-terminated arguments
+    std::vector<size_t> offsets_;      // start of each argument in buffer_
+    std::vector<const wchar_t *> argv_;
+    int argc_;
+    Quote quote_;
+    bool in_token_;
+    bool token_quoted_;      // the current argument has quotes or backslashes
+    bool last_token_quoted_; // the same for the last argument ended
+    bool continued_;  // the input ends with an escaped newline
+    Status status_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_ARGV_TOKENIZER_H
@@ -0,0 +1,76 @@
+#include "command_table.h"
+#include "../command.h"
+#include <cwchar>
+
+namespace exole {
+namespace detail {
+
+static const size_t INITIAL_SLOTS = 16;
+
+CommandTable::CommandTable()
+: slots_(INITIAL_SLOTS, Slot{0, nullptr})
+, size_(0)
+{
+}
+
+size_t CommandTable::hash(const wchar_t *name, size_t len)
+{
+    // FNV-1a
+    size_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= size_t(name[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool CommandTable::insert(Command *command)
+{
+    const std::wstring &name = command->name();
+    if (find(name.data(), name.size()))
+        return false;
+    if (2 * (size_ + 1) > slots_.size()) // keep the load factor under 0.5
+        grow();
+
+    size_t h = hash(name.data(), name.size());
+    size_t mask = slots_.size() - 1;
+    size_t i = h & mask;
+    while (slots_[i].command)
+        i = (i + 1) & mask;
+    slots_[i] = Slot{h, command};
+    size_++;
+    return true;
+}
+
+Command *CommandTable::find(const wchar_t *name, size_t len) const
+{
+    size_t h = hash(name, len);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = h & mask; slots_[i].command; i = (i + 1) & mask) {
+        const Slot &slot = slots_[i];
+        if (slot.hash == h) {
+            const std::wstring &key = slot.command->name();
+            if (key.size() == len && 0 == wmemcmp(key.data(), name, len))
+                return slot.command;
+        }
+    }
+    return nullptr;
+}
+
+void CommandTable::grow()
+{
+    std::vector<Slot> old(slots_.size() * 2, Slot{0, nullptr});
+    old.swap(slots_);
+    size_t mask = slots_.size() - 1;
+    for (const Slot &slot : old) {
+        if (!slot.command)
+            continue;
+        size_t i = slot.hash & mask;
+        while (slots_[i].command)
+            i = (i + 1) & mask;
+        slots_[i] = slot;
+    }
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,41 @@
+#ifndef EXOLE_COMMAND_TABLE_H
+#define EXOLE_COMMAND_TABLE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace exole {
+
+class Command;
+
+namespace detail {
+
+/// An open addressing hash table of commands keyed by name, for exact lookup without building a std::wstring.
+class CommandTable {
+public:
+    CommandTable();
+
+    /// \return false if there is already a command with the same name.
+    bool insert(Command *command);
+
+    Command *find(const wchar_t *name, size_t len) const;
+
+private:
+    struct Slot
+    {
+        size_t hash;
+        Command *command; // nullptr if the slot is empty
+    };
+
+    static size_t hash(const wchar_t *name, size_t len);
+    void grow();
+
+    std::vector<Slot> slots_; // the size is a power of 2
+    size_t size_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_COMMAND_TABLE_H
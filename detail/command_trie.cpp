@@ -0,0 +1,118 @@
+#include "command_trie.h"
+#include <algorithm>
+#include <cassert>
+
+namespace exole {
+namespace detail {
+
+CommandTrie::CommandTrie()
+{
+}
+
+CommandTrie::~CommandTrie()
+{
+}
+
+CommandTrie::Node *CommandTrie::Node::find_child(wchar_t c) const
+{
+    auto it = std::lower_bound(children.begin(), children.end(), c,
+            [](const std::unique_ptr<Node> &node, wchar_t ch) { return node->label[0] < ch; });
+    return (it != children.end() && (*it)->label[0] == c) ? it->get() : nullptr;
+}
+
+void CommandTrie::Node::add_child(std::unique_ptr<Node> child)
+{
+    wchar_t c = child->label[0];
+    auto it = std::lower_bound(children.begin(), children.end(), c,
+            [](const std::unique_ptr<Node> &node, wchar_t ch) { return node->label[0] < ch; });
+    children.insert(it, std::move(child));
+}
+
+void CommandTrie::Node::collect(std::vector<Command *> &result) const
+{
+    if (command)
+        result.push_back(command);
+    for (const auto &child : children) {
+        child->collect(result);
+    }
+}
+
+bool CommandTrie::insert(const std::wstring &name, Command *command)
+{
+    Node *node = &root_;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        Node *child = node->find_child(name[pos]);
+        if (!child) {
+            std::unique_ptr<Node> leaf(new Node);
+            leaf->label = name.substr(pos);
+            leaf->command = command;
+            node->add_child(std::move(leaf));
+            return true;
+        }
+
+        // length of the common part of the label and the rest of the name
+        const std::wstring &label = child->label;
+        size_t n = 0;
+        while (n < label.size() && pos + n < name.size() && label[n] == name[pos + n])
+            n++;
+
+        if (n < label.size()) {
+            // split the edge: node -> middle -> child
+            std::unique_ptr<Node> middle(new Node);
+            middle->label = label.substr(0, n);
+            auto it = std::find_if(node->children.begin(), node->children.end(),
+                    [child](const std::unique_ptr<Node> &p) { return p.get() == child; });
+            assert(it != node->children.end());
+            std::unique_ptr<Node> old(it->release());
+            old->label.erase(0, n);
+            middle->add_child(std::move(old));
+            it->reset(middle.release());
+            child = it->get();
+        }
+        node = child;
+        pos += n;
+    }
+    if (node->command)
+        return false;
+    node->command = command;
+    return true;
+}
+
+void CommandTrie::match_by_prefix(const wchar_t *prefix, size_t len, std::vector<Command *> &result,
+                                  std::wstring &completion) const
+{
+    completion.clear();
+
+    // find the node of the prefix, which may end in the middle of an edge
+    const Node *node = &root_;
+    size_t pos = 0;
+    size_t matched = 0; // number of matched characters of node->label
+    while (pos < len) {
+        node = node->find_child(prefix[pos]);
+        if (!node)
+            return;
+        const std::wstring &label = node->label;
+        matched = 0;
+        while (matched < label.size() && pos < len && label[matched] == prefix[pos]) {
+            matched++;
+            pos++;
+        }
+        if (matched < label.size() && pos < len) // mismatch
+            return;
+    }
+
+    node->collect(result);
+    if (result.empty())
+        return;
+
+    // The rest of the edge is common to all matches, then follow the path until it branches.
+    completion.assign(node->label, matched, std::wstring::npos);
+    while (!node->command && node->children.size() == 1) {
+        node = node->children[0].get();
+        completion += node->label;
+    }
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,50 @@
+#ifndef EXOLE_COMMAND_TRIE_H
+#define EXOLE_COMMAND_TRIE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace exole {
+
+class Command;
+
+namespace detail {
+
+/// A radix tree of commands keyed by name.
+/// Prefix matching takes time proportional to the length of the prefix plus the number of matches.
+/// For exact lookup, see CommandTable.
+class CommandTrie {
+public:
+    CommandTrie();
+    ~CommandTrie();
+
+    /// \return false if there is already a command with the same name.
+    bool insert(const std::wstring &name, Command *command);
+
+    /// Find the commands whose names start with \a prefix, in lexicographical order of names.
+    /// \param completion set to the longest common completion of the matched names, i.e. their common prefix
+    ///                   without \a prefix.
+    void match_by_prefix(const wchar_t *prefix, size_t len, std::vector<Command *> &result,
+                         std::wstring &completion) const;
+
+private:
+    struct Node
+    {
+        std::wstring label; // edge label from the parent
+        Command *command;   // nullptr if no command ends here
+        std::vector<std::unique_ptr<Node>> children; // sorted by the first character of labels
+
+        Node() : command(nullptr) {}
+        Node *find_child(wchar_t c) const;
+        void add_child(std::unique_ptr<Node> child);
+        void collect(std::vector<Command *> &result) const;
+    };
+
+    Node root_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_COMMAND_TRIE_H
@@ -0,0 +1,146 @@
+#include "completion_runner.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace exole {
+namespace detail {
+
+struct CompletionRunner::Request
+{
+    Complete complete;
+    std::atomic<bool> cancelled;
+    std::mutex mutex; // guards the results
+    std::vector<CompletionItem> partial;
+    CompletionSink sink;
+    bool done;
+
+    Request(Complete c, size_t limit)
+    : complete(std::move(c))
+    , cancelled(false)
+    , sink(limit)
+    , done(false)
+    {
+        sink.set_mutex(&mutex); // finish() copies the candidates of a request which is still running
+    }
+};
+
+static thread_local CompletionRunner::Request *current_request = nullptr;
+
+CompletionRunner::CompletionRunner()
+: pool_(new ThreadPool(1))
+, pending_(0)
+{
+    if (::pipe2(notify_pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        notify_pipe_[0] = notify_pipe_[1] = -1;
+    }
+}
+
+CompletionRunner::~CompletionRunner()
+{
+    if (request_) {
+        request_->cancelled = true;
+    }
+    pool_.reset(); // joins the helper thread
+    for (int fd : notify_pipe_) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+}
+
+void CompletionRunner::start(Complete complete, size_t limit)
+{
+    if (request_) {
+        request_->cancelled = true;
+    }
+    char buf[64];
+    while (notify_pipe_[0] >= 0 && ::read(notify_pipe_[0], buf, sizeof(buf)) > 0) {
+    }
+
+    std::shared_ptr<Request> request = std::make_shared<Request>(std::move(complete), limit);
+    request_ = request;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_++;
+    }
+    pool_->submit([this, request] {
+        if (!request->cancelled) { // not superseded before it starts
+            current_request = request.get();
+            request->complete(request->sink); // not read until done
+            current_request = nullptr;
+
+            std::lock_guard<std::mutex> lock(request->mutex);
+            request->done = true;
+        }
+        if (notify_pipe_[1] >= 0) {
+            char c = 0;
+            ssize_t n = ::write(notify_pipe_[1], &c, 1); // a full pipe is already readable
+            (void)n;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_--;
+        idle_cond_.notify_all();
+    });
+}
+
+bool CompletionRunner::done()
+{
+    char buf[64];
+    while (notify_pipe_[0] >= 0 && ::read(notify_pipe_[0], buf, sizeof(buf)) > 0) {
+    }
+    if (!request_)
+        return true;
+    std::lock_guard<std::mutex> lock(request_->mutex);
+    return request_->done;
+}
+
+bool CompletionRunner::finish(CompletionSink &sink)
+{
+    if (!request_)
+        return false;
+    std::shared_ptr<Request> request = std::move(request_);
+    std::lock_guard<std::mutex> lock(request->mutex);
+    if (request->done) {
+        sink = std::move(request->sink);
+        sink.set_mutex(nullptr);
+        return true;
+    }
+    request->cancelled = true;
+    sink.clear();
+    for (const auto &candidate : request->partial) {
+        sink.add(candidate);
+    }
+    for (const auto &candidate : request->sink.items()) { // added by a streaming completer
+        sink.add(candidate);
+    }
+    sink.stop();
+    request->partial.clear();
+    return false;
+}
+
+void CompletionRunner::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cond_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool CompletionRunner::cancelled()
+{
+    return current_request && current_request->cancelled.load();
+}
+
+void CompletionRunner::report(const std::vector<CompletionItem> &candidates)
+{
+    Request *request = current_request;
+    if (!request || request->cancelled)
+        return;
+    std::lock_guard<std::mutex> lock(request->mutex);
+    request->partial.insert(request->partial.end(), candidates.begin(), candidates.end());
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,59 @@
+#ifndef EXOLE_COMPLETION_RUNNER_H
+#define EXOLE_COMPLETION_RUNNER_H
+
+#include "../completion_sink.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+class ThreadPool;
+
+/// Runs completion on a helper thread, so that a slow completer does not freeze the keyboard.
+/// See Application::set_completion_deadline().
+class CompletionRunner {
+public:
+    typedef std::function<void(CompletionSink &sink)> Complete;
+    struct Request;
+
+    CompletionRunner();
+    /// Cancels the request and waits for it.
+    ~CompletionRunner();
+
+    /// Start a request, which keeps no more than \a limit candidates.
+    /// The previous request is cancelled, and dropped if it has not started.
+    void start(Complete complete, size_t limit);
+    /// A file descriptor which becomes readable when a request finishes.
+    int notify_fd() const { return notify_pipe_[0]; }
+    /// \return true if the last request has finished.
+    bool done();
+    /// Take the result of the last request if it has finished. Otherwise cancel it, and take the candidates
+    /// it has reported or added to its sink so far.
+    /// \return true if the request has finished.
+    bool finish(CompletionSink &sink);
+    /// Wait for the cancelled requests to return, e.g. before running a command.
+    void wait_idle();
+
+    /// \return true if the request running on the calling thread has been cancelled.
+    static bool cancelled();
+    /// Add candidates to the partial result of the request running on the calling thread.
+    static void report(const std::vector<CompletionItem> &candidates);
+
+private:
+    std::shared_ptr<Request> request_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::mutex mutex_;
+    std::condition_variable idle_cond_;
+    int pending_; // requests submitted but not returned
+    int notify_pipe_[2];
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_COMPLETION_RUNNER_H
@@ -0,0 +1,57 @@
+#include "completion_session.h"
+#include "../wcs_util.h"
+
+namespace exole {
+namespace detail {
+
+std::atomic<uint64_t> CompletionSession::generation_counter(0);
+
+CompletionSession::CompletionSession()
+: token_index_(0)
+, generation_(0)
+, valid_(false)
+{
+}
+
+void CompletionSession::save(const std::wstring &head, const std::wstring &tail, size_t token_index,
+                             const std::wstring &prefix, const std::vector<CompletionItem> &candidates,
+                             uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_ = head;
+    tail_ = tail;
+    token_index_ = token_index;
+    prefix_ = prefix;
+    candidates_ = candidates;
+    generation_ = generation;
+    valid_ = true;
+}
+
+bool CompletionSession::narrow(const std::wstring &head, const std::wstring &tail, size_t token_index,
+                               const std::wstring &prefix, std::vector<CompletionItem> &result,
+                               std::wstring &completion)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!valid_ || generation_ != generation() || token_index != token_index_ || prefix.size() < prefix_.size()
+            || 0 != prefix.compare(0, prefix_.size(), prefix_) || head != head_ || tail != tail_) {
+        return false;
+    }
+    result = match_by_prefix(candidates_, [](const CompletionItem &item) -> const std::wstring & { return item.value(); },
+                             prefix, completion);
+    if (result.empty()) {
+        return false; // e.g. the console may try custom_complete() instead
+    }
+    prefix_ = prefix;
+    candidates_ = result;
+    return true;
+}
+
+void CompletionSession::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    valid_ = false;
+    candidates_.clear();
+}
+
+} // namespace detail
+} // namespace exole
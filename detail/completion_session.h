@@ -0,0 +1,53 @@
+#ifndef EXOLE_COMPLETION_SESSION_H
+#define EXOLE_COMPLETION_SESSION_H
+
+#include "../completion.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+/// The candidates of the last completion of a console, see Console::auto_complete().
+/// When the user types more of the same token and presses Tab again, the candidates are narrowed
+/// rather than computed again. The candidates of every session are forgotten when a command is added or run,
+/// since either can change them.
+class CompletionSession {
+public:
+    CompletionSession();
+
+    /// Remember the candidates for \a prefix of the token at \a token_index , between \a head and \a tail ,
+    /// which are the text before the token and the text after the cursor.
+    /// \param generation the generation() before the candidates were computed.
+    void save(const std::wstring &head, const std::wstring &tail, size_t token_index, const std::wstring &prefix,
+              const std::vector<CompletionItem> &candidates, uint64_t generation);
+    /// If only the token has been extended since save(), find the remembered candidates starting with \a prefix .
+    /// \return false if the candidates must be computed again.
+    bool narrow(const std::wstring &head, const std::wstring &tail, size_t token_index, const std::wstring &prefix,
+                std::vector<CompletionItem> &result, std::wstring &completion);
+    void clear();
+
+    /// Forget the candidates of all sessions, e.g. when a command is added or run.
+    static void invalidate_all() { generation_counter.fetch_add(1, std::memory_order_release); }
+    static uint64_t generation() { return generation_counter.load(std::memory_order_acquire); }
+
+private:
+    static std::atomic<uint64_t> generation_counter;
+
+    std::mutex mutex_;
+    std::wstring head_;
+    std::wstring tail_;
+    size_t token_index_;
+    std::wstring prefix_;
+    std::vector<CompletionItem> candidates_;
+    uint64_t generation_; // generation() when the candidates were computed
+    bool valid_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_COMPLETION_SESSION_H
@@ -0,0 +1,271 @@
+#include "dir_cache.h"
+#include "../application.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace exole {
+namespace detail {
+
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                 | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+static const size_t DENTS_BUFFER_SIZE = 64 * 1024;
+
+// f_type of file systems which can be changed by other machines or by a user space server, see statfs(2)
+static const unsigned long REMOTE_FS_MAGICS[] = {
+    0x6969,     // NFS
+    0x517b,     // SMB
+    0xff534d42, // CIFS
+    0xfe534d42, // SMB2
+    0x65735546, // FUSE, e.g. sshfs
+    0x73757245, // Coda
+    0x5346414f, // AFS
+    0x6b414653, // kAFS
+    0x00c36400, // Ceph
+    0x01021997, // 9p
+    0x01161970, // GFS2
+    0x7461636f, // OCFS2
+};
+
+// A record returned by getdents64(2)
+struct LinuxDirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1]; // NUL-terminated, of variable length
+};
+
+// Call visit(name, len, d_type) for each entry of an open directory but "." and "..".
+// Entries are read in bulk, rather than one by one with readdir().
+template <typename Visit>
+static bool for_each_dirent(int fd, Visit visit)
+{
+    std::vector<char> buf(DENTS_BUFFER_SIZE);
+    while (true) {
+        if (Application::completion_cancelled()) {
+            return false;
+        }
+        long n = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (n == 0) {
+            return true;
+        }
+        for (long pos = 0; pos < n; ) {
+            const LinuxDirent64 *ent = (const LinuxDirent64 *)(buf.data() + pos);
+            pos += ent->d_reclen;
+            const char *name = ent->d_name;
+            size_t len = strlen(name);
+            if (name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.'))) {
+                continue;
+            }
+            visit(name, len, ent->d_type);
+        }
+    }
+}
+
+// Some file systems do not report file types in directories.
+static unsigned char resolve_type(int dir_fd, const char *name, unsigned char d_type)
+{
+    if (d_type != DT_UNKNOWN) {
+        return d_type;
+    }
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return DT_UNKNOWN; // e.g. removed
+    }
+    return IFTODT(st.st_mode);
+}
+
+static FileType file_type(unsigned char d_type)
+{
+    switch (d_type) {
+    case DT_REG: return FT_REGULAR_FILE;
+    case DT_DIR: return FT_DIRECTORY;
+    default: return FT_UNKNOWN; // TODO: handle other file types
+    }
+}
+
+static inline bool has_prefix(const char *name, size_t len, const std::string &prefix)
+{
+    return len >= prefix.size() && 0 == memcmp(name, prefix.data(), prefix.size());
+}
+
+DirCache::DirCache(size_t capacity)
+: capacity_(capacity)
+, inotify_fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+}
+
+DirCache::~DirCache()
+{
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_); // removes the watches
+    }
+}
+
+bool DirCache::list(const std::string &dir_name, const std::string &prefix, int types, std::vector<Entry> &result)
+{
+    int fd = ::open(dir_name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    size_t first = result.size();
+    bool ok = for_each_dirent(fd, [&](const char *name, size_t len, unsigned char d_type) {
+        if (!has_prefix(name, len, prefix))
+            return;
+        FileType type = file_type(resolve_type(fd, name, d_type));
+        if (type & types)
+            result.push_back(Entry{std::string(name, len), type});
+    });
+    ::close(fd);
+    std::sort(result.begin() + first, result.end(),
+              [](const Entry &lhs, const Entry &rhs) { return lhs.name < rhs.name; });
+    return ok;
+}
+
+bool DirCache::read_dir(const std::string &path, Listing &listing)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = for_each_dirent(fd, [&listing](const char *name, size_t len, unsigned char d_type) {
+        if (d_type != DT_UNKNOWN && file_type(d_type) == FT_UNKNOWN)
+            return; // never matches
+        listing.entries.push_back(Dirent{uint32_t(listing.names.size()), uint32_t(len), d_type});
+        listing.names.append(name, len);
+    });
+    ::close(fd);
+
+    const char *names = listing.names.data();
+    std::sort(listing.entries.begin(), listing.entries.end(), [names](const Dirent &lhs, const Dirent &rhs) {
+        int ret = memcmp(names + lhs.offset, names + rhs.offset, std::min(lhs.len, rhs.len));
+        return ret != 0 ? ret < 0 : lhs.len < rhs.len;
+    });
+    return ok;
+}
+
+bool DirCache::is_watchable(const std::string &path)
+{
+    struct statfs st;
+    if (statfs(path.c_str(), &st) != 0) {
+        return false;
+    }
+    unsigned long type = (unsigned long)st.f_type & 0xffffffffUL; // f_type is signed on some platforms
+    return std::find(std::begin(REMOTE_FS_MAGICS), std::end(REMOTE_FS_MAGICS), type) == std::end(REMOTE_FS_MAGICS);
+}
+
+void DirCache::read_events()
+{
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t n;
+    while ((n = ::read(inotify_fd_, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) { // events are lost
+                while (!lru_.empty())
+                    drop(lru_.begin());
+                continue;
+            }
+            auto it = by_wd_.find(event->wd);
+            if (it != by_wd_.end()) {
+                drop(it->second);
+            }
+        }
+    }
+}
+
+void DirCache::drop(LruList::iterator it)
+{
+    inotify_rm_watch(inotify_fd_, it->wd); // fails harmlessly if the kernel has removed it
+    by_wd_.erase(it->wd);
+    by_path_.erase(it->path);
+    lru_.erase(it);
+}
+
+bool DirCache::match(const std::string &dir_name, const std::string &prefix, int types, std::vector<Entry> &result)
+{
+    char real_path[PATH_MAX];
+    if (inotify_fd_ < 0 || !realpath(dir_name.c_str(), real_path)) {
+        return list(dir_name, prefix, types, result);
+    }
+    std::string path = real_path;
+    if (!is_watchable(path)) { // before locking, since a network file system may not respond
+        return list(path, prefix, types, result);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_events();
+    auto found = by_path_.find(path);
+    LruList::iterator it;
+    if (found != by_path_.end()) {
+        it = found->second;
+        lru_.splice(lru_.begin(), lru_, it);
+    }
+    else {
+        // Watch before reading, so that a change during reading is reported.
+        int wd = inotify_add_watch(inotify_fd_, path.c_str(), WATCH_MASK);
+        if (wd < 0 || by_wd_.count(wd)) { // e.g. too many watches, or the same directory by another path
+            return list(path, prefix, types, result);
+        }
+        Listing listing;
+        listing.path = path;
+        listing.wd = wd;
+        if (!read_dir(path, listing)) {
+            inotify_rm_watch(inotify_fd_, wd);
+            return false;
+        }
+        lru_.push_front(std::move(listing));
+        by_path_[path] = lru_.begin();
+        by_wd_[wd] = lru_.begin();
+        while (lru_.size() > capacity_) {
+            drop(std::prev(lru_.end()));
+        }
+        read_events(); // drops the listing if the directory has changed during reading
+        if (!by_wd_.count(wd)) { // hardly ever
+            return list(path, prefix, types, result);
+        }
+        it = lru_.begin();
+    }
+
+    // the entries starting with the prefix are adjacent
+    Listing &listing = *it;
+    const char *names = listing.names.data();
+    auto entry = std::lower_bound(listing.entries.begin(), listing.entries.end(), prefix,
+                                  [names](const Dirent &d, const std::string &p) {
+        int ret = memcmp(names + d.offset, p.data(), std::min<size_t>(d.len, p.size()));
+        return ret != 0 ? ret < 0 : d.len < p.size();
+    });
+    for (; entry != listing.entries.end() && has_prefix(names + entry->offset, entry->len, prefix); ++entry) {
+        std::string name(names + entry->offset, entry->len);
+        if (entry->d_type == DT_UNKNOWN) {
+            entry->d_type = resolve_type(AT_FDCWD, (path + '/' + name).c_str(), DT_UNKNOWN);
+        }
+        FileType type = file_type(entry->d_type);
+        if (type & types) {
+            result.push_back(Entry{std::move(name), type});
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+} // namespace exole
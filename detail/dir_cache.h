@@ -0,0 +1,73 @@
+#ifndef EXOLE_DIR_CACHE_H
+#define EXOLE_DIR_CACHE_H
+
+#include "../file_name_completer.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+/// Sorted listings of recently completed directories, for FileNameCompleter.
+/// A listing is dropped when inotify reports a change in its directory. inotify sees only the changes made
+/// through the local kernel, so directories on network and FUSE file systems, e.g. NFS, CIFS or sshfs, are read
+/// every time like those which cannot be watched.
+class DirCache {
+public:
+    struct Entry
+    {
+        std::string name; // in multibyte encoding, as in the directory
+        FileType type;
+    };
+
+    explicit DirCache(size_t capacity);
+    ~DirCache();
+
+    /// Find the files in \a dir_name whose names start with \a prefix , in the order of names.
+    /// \return false if the directory cannot be read.
+    bool match(const std::string &dir_name, const std::string &prefix, int types, std::vector<Entry> &result);
+
+    /// Read the files in \a dir_name whose names start with \a prefix , without caching.
+    /// Names are compared before they are copied, so reading is fast even if few names match.
+    /// \return false if the directory cannot be read.
+    static bool list(const std::string &dir_name, const std::string &prefix, int types, std::vector<Entry> &result);
+
+private:
+    struct Dirent
+    {
+        uint32_t offset; // of the name in Listing::names
+        uint32_t len;
+        unsigned char d_type; // DT_UNKNOWN until it matches, see match()
+    };
+    struct Listing
+    {
+        std::string path; // the real path of the directory
+        int wd;           // the inotify watch
+        std::string names; // the names one after another
+        std::vector<Dirent> entries; // sorted by name
+    };
+    typedef std::list<Listing> LruList; // the most recently used first
+
+    static bool read_dir(const std::string &path, Listing &listing);
+    /// \return true if inotify reports every change in the directory, i.e. it is not on a network or FUSE file system.
+    static bool is_watchable(const std::string &path);
+    /// Drop the listings of the changed directories.
+    void read_events();
+    void drop(LruList::iterator it);
+
+    std::mutex mutex_;
+    LruList lru_;
+    std::unordered_map<std::string, LruList::iterator> by_path_;
+    std::unordered_map<int, LruList::iterator> by_wd_;
+    size_t capacity_;
+    int inotify_fd_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_DIR_CACHE_H
@@ -0,0 +1,245 @@
+#include "history_store.h"
+#include "../wcs_util.h"
+#include <histedit.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace exole {
+namespace detail {
+
+static const char LIBEDIT_MAGIC[] = "_HiStOrY_V2_\n";
+
+static inline uint32_t trigram(const char *p)
+{
+    return (uint32_t((unsigned char)p[0]) << 16) | (uint32_t((unsigned char)p[1]) << 8) | (unsigned char)p[2];
+}
+
+// In the log, '\n' is written as "\\n", and '\\' as "\\\\".
+static void escape(const char *data, size_t len, std::string &out)
+{
+    for (size_t i = 0; i < len; i++) {
+        switch (data[i]) {
+        case '\n': out += "\\n"; break;
+        case '\\': out += "\\\\"; break;
+        default: out += data[i]; break;
+        }
+    }
+}
+
+static void unescape(const char *data, size_t len, std::string &out)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\\' && i + 1 < len) {
+            i++;
+            out += (data[i] == 'n') ? '\n' : data[i];
+        }
+        else {
+            out += data[i];
+        }
+    }
+}
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+HistoryStore::HistoryStore()
+: offsets_(1, 0)
+, fd_(-1)
+, unterminated_(false)
+{
+}
+
+HistoryStore::~HistoryStore()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool HistoryStore::open(const std::string &filename)
+{
+    int fd = ::open(filename.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    std::string content;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        content.resize(st.st_size);
+        ssize_t n = ::pread(fd, &content[0], content.size(), 0);
+        content.resize(n > 0 ? n : 0);
+    }
+
+    if (content.compare(0, sizeof(LIBEDIT_MAGIC) - 1, LIBEDIT_MAGIC) == 0) {
+        // saved by libedit, convert it to a log
+        ::close(fd);
+        if (!import_libedit_history(filename) || !write_log(filename)) {
+            return false;
+        }
+        fd_ = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        return fd_ >= 0;
+    }
+
+    size_t end = content.rfind('\n');
+    end = (end == std::string::npos) ? 0 : end + 1;
+    unterminated_ = end < content.size();
+    std::string line;
+    for (size_t pos = 0; pos < end; ) {
+        size_t nl = content.find('\n', pos);
+        if (nl > pos) { // empty after a line which was unterminated when another session opened the log
+            line.clear();
+            unescape(content.data() + pos, nl - pos, line);
+            add(line.data(), line.size());
+        }
+        pos = nl + 1;
+    }
+    fd_ = fd;
+    return true;
+}
+
+bool HistoryStore::import_libedit_history(const std::string &filename)
+{
+    HistoryW *history = history_winit();
+    HistEventW event;
+    history_w(history, &event, H_SETSIZE, 0x7fffffff);
+    if (history_w(history, &event, H_LOAD, filename.c_str()) == -1) {
+        history_wend(history);
+        return false;
+    }
+    // from the oldest one
+    for (int ret = history_w(history, &event, H_LAST); ret != -1; ret = history_w(history, &event, H_PREV)) {
+        std::string line = wcs_to_mbs(event.str);
+        if (!line.empty() && line.back() == '\n')
+            line.pop_back();
+        if (!line.empty())
+            add(line.data(), line.size());
+    }
+    history_wend(history);
+    return true;
+}
+
+bool HistoryStore::write_log(const std::string &filename) const
+{
+    // write a new file, then replace the old one, so that the history is never half written
+    std::string temp = filename + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    std::string out;
+    for (size_t i = 0; i < size(); i++) {
+        escape(data_.data() + offsets_[i], offsets_[i + 1] - offsets_[i], out);
+        out += '\n';
+    }
+    bool ok = write_all(fd, out.data(), out.size()) && ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || ::rename(temp.c_str(), filename.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void HistoryStore::add(const char *data, size_t len)
+{
+    uint32_t index = size();
+    data_.append(data, len);
+    offsets_.push_back(data_.size());
+    for (size_t i = 0; i + 3 <= len; i++) {
+        std::vector<uint32_t> &posting = postings_[trigram(data + i)];
+        if (posting.empty() || posting.back() != index) // once per entry
+            posting.push_back(index);
+    }
+}
+
+void HistoryStore::append(const std::wstring &line)
+{
+    size_t len = line.size();
+    if (len > 0 && line[len - 1] == L'\n')
+        len--;
+    if (len == 0)
+        return;
+    std::string mbs = wcs_to_mbs(line.c_str(), len);
+    if (mbs.empty())
+        return;
+    size_t n = size();
+    if (n > 0 && 0 == data_.compare(offsets_[n - 1], offsets_[n] - offsets_[n - 1], mbs))
+        return; // same as the last one
+    add(mbs.data(), mbs.size());
+
+    if (fd_ >= 0) {
+        // one write per entry, so that entries of concurrent sessions do not interleave
+        std::string out;
+        if (unterminated_) {
+            out += '\n';
+            unterminated_ = false;
+        }
+        escape(mbs.data(), mbs.size(), out);
+        out += '\n';
+        write_all(fd_, out.data(), out.size());
+    }
+}
+
+std::wstring HistoryStore::entry(size_t index) const
+{
+    return mbs_to_wcs(data_.data() + offsets_[index], offsets_[index + 1] - offsets_[index]);
+}
+
+long HistoryStore::search(const std::wstring &query, size_t before) const
+{
+    std::string q = wcs_to_mbs(query);
+    if (q.empty())
+        return -1;
+    before = std::min(before, size());
+
+    auto contains = [this, &q](size_t index) {
+        const char *begin = data_.data() + offsets_[index];
+        const char *end = data_.data() + offsets_[index + 1];
+        return std::search(begin, end, q.begin(), q.end()) != end;
+    };
+
+    if (q.size() < 3) { // too short for the index
+        for (size_t i = before; i > 0; i--) {
+            if (contains(i - 1))
+                return i - 1;
+        }
+        return -1;
+    }
+
+    // Check the entries in the shortest posting list of the trigrams of the query.
+    const std::vector<uint32_t> *shortest = nullptr;
+    for (size_t i = 0; i + 3 <= q.size(); i++) {
+        auto it = postings_.find(trigram(q.data() + i));
+        if (it == postings_.end())
+            return -1;
+        if (!shortest || it->second.size() < shortest->size())
+            shortest = &it->second;
+    }
+    auto it = std::lower_bound(shortest->begin(), shortest->end(), uint32_t(before));
+    while (it != shortest->begin()) {
+        --it;
+        if (contains(*it))
+            return *it;
+    }
+    return -1;
+}
+
+} // namespace detail
+} // namespace exole
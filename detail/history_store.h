@@ -0,0 +1,55 @@
+#ifndef EXOLE_HISTORY_STORE_H
+#define EXOLE_HISTORY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+/// The command history of all sessions, kept in an append-only log with one entry per line.
+/// Entries are appended as they run, so the history survives a crash. An unterminated last line, e.g. cut short
+/// by a crash or being appended by another session, is ignored when the log is loaded, but never truncated,
+/// since another session may be completing it. A history file saved by libedit is converted when it is opened.
+///
+/// Entries are indexed by their trigrams, so searching millions of entries only checks those which
+/// contain all the trigrams of the query.
+class HistoryStore {
+public:
+    HistoryStore();
+    ~HistoryStore();
+
+    /// Open or create the log, and load its entries.
+    /// \return false if the log cannot be opened. The entries can still be added, but are not saved.
+    bool open(const std::string &filename);
+
+    /// Add an entry and append it to the log. An entry same as the last one is ignored.
+    void append(const std::wstring &line);
+
+    size_t size() const { return offsets_.size() - 1; }
+    std::wstring entry(size_t index) const;
+
+    /// Find the newest entry containing \a query, among the entries before \a before .
+    /// \return the index of the entry, or -1 if not found.
+    long search(const std::wstring &query, size_t before) const;
+
+private:
+    /// Add an unescaped entry in multibyte encoding to the memory and the index.
+    void add(const char *data, size_t len);
+    bool import_libedit_history(const std::string &filename);
+    bool write_log(const std::string &filename) const;
+
+    std::string data_;            // the entries one after another
+    std::vector<size_t> offsets_; // start of each entry in data_, and the end
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings_; // indexes of entries by trigram
+    int fd_;
+    bool unterminated_; // the log did not end with '\n' when opened, so the next entry starts a line
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_HISTORY_STORE_H
@@ -0,0 +1,334 @@
+#include "server.h"
+#include "../application.h"
+#include "../console.h"
+#include "../wcs_util.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace exole {
+namespace detail {
+
+static const size_t READ_SIZE = 64 * 1024;
+static const int MAX_EVENTS = 64;
+static const char LEAVE_CONSOLE = '\x04'; // a line of Ctrl-D
+
+Server::Server(Application &app, ContextFactory context_factory)
+: app_(app)
+, context_factory_(context_factory)
+, listen_fd_(-1)
+, epoll_fd_(-1)
+, read_buffer_(READ_SIZE)
+{
+}
+
+Server::~Server()
+{
+    while (!connections_.empty()) {
+        close_connection(*connections_.begin()->second);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+}
+
+/// Remove the socket at \a addr left by a previous run. Anything else there is kept, including the socket of
+/// a server still listening on it.
+/// \return false if the path is taken.
+static bool remove_stale_socket(const struct sockaddr_un &addr)
+{
+    const char *path = addr.sun_path;
+    struct stat st;
+    if (::lstat(path, &st) != 0) {
+        if (errno == ENOENT)
+            return true;
+        fprintf(stderr, "cannot listen on '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        fprintf(stderr, "cannot listen on '%s': the file exists and is not a socket\n", path);
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    int ret = ::connect(fd, (const struct sockaddr *)&addr, sizeof(addr));
+    int error = errno;
+    ::close(fd);
+    if (ret == 0) {
+        fprintf(stderr, "cannot listen on '%s': another server is listening on it\n", path);
+        return false;
+    }
+    if (error != ECONNREFUSED) {
+        fprintf(stderr, "cannot listen on '%s': %s\n", path, strerror(error));
+        return false;
+    }
+    ::unlink(path);
+    return true;
+}
+
+bool Server::listen(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path is too long: '%s'\n", socket_path);
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    if (!remove_stale_socket(addr)) {
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    if (::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "cannot listen on '%s': %s\n", socket_path, strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    socket_path_ = socket_path;
+
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        perror("epoll_create1");
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // the listening socket
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) != 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
+void Server::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+    while (app_.serving_) {
+        int n = ::epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n && app_.serving_; i++) {
+            Connection *c = (Connection *)events[i].data.ptr;
+            if (!c) {
+                accept_connections();
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                write_output(*c);
+            }
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read_input(*c);
+            }
+        }
+    }
+}
+
+void Server::accept_connections()
+{
+    while (true) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept4");
+            return;
+        }
+
+        std::unique_ptr<Connection> conn(new Connection);
+        Connection &c = *conn;
+        c.fd = fd;
+        c.events = EPOLLIN;
+        c.output_pos = 0;
+        c.closing = false;
+        c.session.context = context_factory_ ? context_factory_() : nullptr;
+        c.session.output.set_capture(&c.output, &c.output);
+        struct epoll_event event;
+        event.events = c.events;
+        event.data.ptr = &c;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            perror("epoll_ctl");
+            ::close(fd);
+            continue;
+        }
+        connections_[fd] = std::move(conn);
+
+        // start from the root console, just like Application::run()
+        switch_to(&c);
+        CommandHandle root;
+        app_.resolve_command(nullptr, 0, &root);
+        c.session.console_stack.push_back(static_cast<Console *>(root.command()));
+        app_.update_prompt();
+        Output *old_output = Output::set_current(&c.session.output);
+        app_.current_console()->on_enter_console(app_);
+        Output::set_current(old_output);
+        c.session.output.flush();
+        send_prompt(c);
+        switch_to(nullptr);
+        write_output(c);
+    }
+}
+
+void Server::read_input(Connection &c)
+{
+    // Read once per event, so that a busy connection does not starve the others.
+    ssize_t n = ::read(c.fd, read_buffer_.data(), read_buffer_.size());
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return;
+        close_connection(c);
+        return;
+    }
+
+    const char *data = read_buffer_.data();
+    const char *end = data + n;
+    switch_to(&c);
+    while (!c.closing) {
+        const char *nl = (const char *)memchr(data, '\n', end - data);
+        if (!nl)
+            break;
+        if (c.input.empty()) {
+            run_line(c, data, nl - data);
+        }
+        else {
+            c.input.append(data, nl);
+            run_line(c, c.input.data(), c.input.size());
+            c.input.clear();
+        }
+        data = nl + 1;
+    }
+    if (!c.closing) {
+        c.input.append(data, end);
+        if (n == 0) { // end of input, the last line may have no newline
+            if (!c.input.empty())
+                run_line(c, c.input.data(), c.input.size());
+            c.closing = true;
+        }
+    }
+    switch_to(nullptr);
+    write_output(c);
+}
+
+void Server::run_line(Connection &c, const char *line, size_t len)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+
+    if (len == 1 && line[0] == LEAVE_CONSOLE) {
+        // like Ctrl-D in Application::run()
+        if (app_.has_partial_command()) {
+            app_.discard_partial_command();
+        }
+        else {
+            Output *old_output = Output::set_current(&c.session.output);
+            app_.leave_console();
+            if (!c.session.console_stack.empty()) {
+                app_.current_console()->on_enter_console(app_);
+            }
+            Output::set_current(old_output);
+            c.session.output.flush();
+            if (c.session.console_stack.empty()) {
+                c.closing = true;
+                return;
+            }
+        }
+    }
+    else {
+        app_.run_command(mbs_to_wcs(line, len));
+    }
+    send_prompt(c);
+}
+
+void Server::send_prompt(Connection &c)
+{
+    c.output += wcs_to_mbs(app_.get_prompt());
+}
+
+void Server::write_output(Connection &c)
+{
+    while (c.output_pos < c.output.size()) {
+        ssize_t n = ::send(c.fd, c.output.data() + c.output_pos, c.output.size() - c.output_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            close_connection(c); // e.g. the client has gone
+            return;
+        }
+        c.output_pos += n;
+    }
+    if (c.output_pos == c.output.size()) {
+        c.output.clear(); // keeps the capacity
+        c.output_pos = 0;
+        if (c.closing) {
+            close_connection(c);
+            return;
+        }
+    }
+    update_events(c);
+}
+
+void Server::update_events(Connection &c)
+{
+    // Stop reading while there is output to send, so a client which does not read cannot make
+    // the output grow without limit.
+    uint32_t events = c.output.empty() ? EPOLLIN : EPOLLOUT;
+    if (events == c.events)
+        return;
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = &c;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &event) == 0)
+        c.events = events;
+}
+
+void Server::close_connection(Connection &c)
+{
+    switch_to(&c);
+    c.session.output.set_capture(nullptr, nullptr);
+    c.session.output.set_fds(-1, -1); // nobody is reading any more
+    Output *old_output = Output::set_current(&c.session.output);
+    while (!c.session.console_stack.empty()) {
+        app_.leave_console();
+    }
+    Output::set_current(old_output);
+    c.session.output.flush();
+    switch_to(nullptr);
+
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    ::close(c.fd);
+    connections_.erase(c.fd); // destroys c
+}
+
+void Server::switch_to(Connection *c)
+{
+    app_.session_ = c ? &c->session : app_.main_session_.get();
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,65 @@
+#ifndef EXOLE_SERVER_H
+#define EXOLE_SERVER_H
+
+#include "session.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace exole {
+
+class Application;
+
+namespace detail {
+
+/// The event loop of Application::serve().
+/// Connections are non-blocking, and their commands run one at a time on the calling thread,
+/// so the commands are never run concurrently, and no thread is created per session.
+class Server {
+public:
+    typedef std::function<std::unique_ptr<CommandContext>()> ContextFactory;
+
+    Server(Application &app, ContextFactory context_factory);
+    ~Server();
+
+    /// \return false if the socket cannot be created.
+    bool listen(const char *socket_path);
+    /// Serve until Application::stop_serving() is called.
+    void run();
+
+private:
+    struct Connection
+    {
+        int fd;
+        uint32_t events;    // the events being polled
+        Session session;
+        std::string input;  // received bytes which do not make a complete line yet
+        std::string output; // bytes to send
+        size_t output_pos;  // bytes of output already sent
+        bool closing;       // close after sending the output
+    };
+
+    void accept_connections();
+    void read_input(Connection &c);
+    void run_line(Connection &c, const char *line, size_t len);
+    void write_output(Connection &c);
+    void update_events(Connection &c);
+    void close_connection(Connection &c);
+    /// Switch the application to the session of \a c , or back to the main session if nullptr.
+    void switch_to(Connection *c);
+    void send_prompt(Connection &c);
+
+    Application &app_;
+    ContextFactory context_factory_;
+    std::string socket_path_;
+    int listen_fd_;
+    int epoll_fd_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::vector<char> read_buffer_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_SERVER_H
@@ -0,0 +1,40 @@
+#ifndef EXOLE_SESSION_H
+#define EXOLE_SESSION_H
+
+#include "../command_context.h"
+#include "../output.h"
+#include "arguments.h"
+#include "argv_tokenizer.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exole {
+
+class Console;
+
+namespace detail {
+
+/// The state of a console session. An application has one session in interactive and batch mode,
+/// and one per connection in server mode, while the commands are shared by all sessions.
+struct Session
+{
+    Session()
+    : tokenizer(new ArgvTokenizer())
+    , prompt(L"> ")
+    {}
+
+    std::vector<Console *> console_stack;
+    std::unique_ptr<CommandContext> context;
+    std::unique_ptr<ArgvTokenizer> tokenizer; // reused by every command
+    Output output;
+    std::wstring prompt;
+    std::wstring partial_line; // lines of an incomplete command, for history
+    std::unordered_map<const Console *, Arguments> last_arguments; // repeated by an empty line in each console
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_SESSION_H
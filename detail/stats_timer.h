@@ -0,0 +1,40 @@
+#ifndef EXOLE_STATS_TIMER_H
+#define EXOLE_STATS_TIMER_H
+
+#include "../command_stats.h"
+#include "../util.h"
+#include <chrono>
+
+namespace exole {
+namespace detail {
+
+/// Records the lifetime of a scope into a histogram.
+class StatsTimer {
+public:
+    explicit StatsTimer(LatencyHistogram &histogram)
+    : histogram_(histogram)
+    , start_(std::chrono::steady_clock::now())
+    {}
+
+    ~StatsTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+private:
+    LatencyHistogram &histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace detail
+} // namespace exole
+
+// The histogram expression is not evaluated unless built with EXOLE_ENABLE_STATS.
+#ifdef EXOLE_ENABLE_STATS
+#define EXOLE_STATS_TIME(HISTOGRAM) \
+    ::exole::detail::StatsTimer EXOLE_CONCAT(exole_stats_timer_, __LINE__)(HISTOGRAM)
+#else
+#define EXOLE_STATS_TIME(HISTOGRAM) do {} while (0)
+#endif
+
+#endif // EXOLE_STATS_TIMER_H
@@ -0,0 +1,55 @@
+#include "thread_pool.h"
+
+namespace exole {
+namespace detail {
+
+ThreadPool::ThreadPool(unsigned num_threads)
+: stopping_(false)
+{
+    if (num_threads == 0)
+        num_threads = 1;
+    threads_.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; i++) {
+        threads_.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    for (auto &t : threads_) {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+}
+
+void ThreadPool::work()
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) // stopping
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,37 @@
+#ifndef EXOLE_THREAD_POOL_H
+#define EXOLE_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace exole {
+namespace detail {
+
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    explicit ThreadPool(unsigned num_threads);
+    /// Runs the remaining tasks, then joins the threads.
+    ~ThreadPool();
+
+    void submit(Task task);
+    unsigned size() const { return threads_.size(); }
+private:
+    void work();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Task> tasks_;
+    std::vector<std::thread> threads_;
+    bool stopping_;
+};
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_THREAD_POOL_H
@@ -0,0 +1,169 @@
+#include "token_scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && __SIZEOF_WCHAR_T__ == 4
+#define EXOLE_TOKEN_SCAN_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace exole {
+namespace detail {
+
+template <ScanMode Mode>
+static inline bool stops(wchar_t c)
+{
+    switch (Mode) {
+    case SM_NORMAL:
+        return c <= 0x20 || c >= 0x7f || c == L'"' || c == L'\'' || c == L'\\';
+    case SM_DQUOTE:
+        return c == L'"' || c == L'\\';
+    case SM_SQUOTE:
+        return c == L'\'';
+    }
+    return true;
+}
+
+template <ScanMode Mode>
+static const wchar_t *scan_scalar(const wchar_t *p, const wchar_t *end)
+{
+    while (p < end && !stops<Mode>(*p))
+        p++;
+    return p;
+}
+
+#ifdef EXOLE_TOKEN_SCAN_SIMD
+
+// 4 characters at a time
+template <ScanMode Mode>
+static const wchar_t *scan_sse2(const wchar_t *p, const wchar_t *end)
+{
+    const __m128i dquote = _mm_set1_epi32(L'"');
+    const __m128i squote = _mm_set1_epi32(L'\'');
+    const __m128i backslash = _mm_set1_epi32(L'\\');
+    const __m128i space = _mm_set1_epi32(0x20);
+    const __m128i del = _mm_set1_epi32(0x7f);
+    while (end - p >= 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i stop;
+        if (Mode == SM_NORMAL) {
+            __m128i printable = _mm_and_si128(_mm_cmpgt_epi32(v, space), _mm_cmplt_epi32(v, del));
+            stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(v, dquote), _mm_cmpeq_epi32(v, squote)),
+                                _mm_cmpeq_epi32(v, backslash));
+            stop = _mm_or_si128(stop, _mm_andnot_si128(printable, _mm_set1_epi32(-1)));
+        }
+        else if (Mode == SM_DQUOTE) {
+            stop = _mm_or_si128(_mm_cmpeq_epi32(v, dquote), _mm_cmpeq_epi32(v, backslash));
+        }
+        else {
+            stop = _mm_cmpeq_epi32(v, squote);
+        }
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(stop));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 4;
+    }
+    return scan_scalar<Mode>(p, end);
+}
+
+// 8 characters at a time
+template <ScanMode Mode>
+__attribute__((target("avx2")))
+static const wchar_t *scan_avx2(const wchar_t *p, const wchar_t *end)
+{
+    const __m256i dquote = _mm256_set1_epi32(L'"');
+    const __m256i squote = _mm256_set1_epi32(L'\'');
+    const __m256i backslash = _mm256_set1_epi32(L'\\');
+    const __m256i space = _mm256_set1_epi32(0x20);
+    const __m256i del = _mm256_set1_epi32(0x7f);
+    while (end - p >= 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i stop;
+        if (Mode == SM_NORMAL) {
+            __m256i printable = _mm256_and_si256(_mm256_cmpgt_epi32(v, space), _mm256_cmpgt_epi32(del, v));
+            stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(v, dquote), _mm256_cmpeq_epi32(v, squote)),
+                                   _mm256_cmpeq_epi32(v, backslash));
+            stop = _mm256_or_si256(stop, _mm256_andnot_si256(printable, _mm256_set1_epi32(-1)));
+        }
+        else if (Mode == SM_DQUOTE) {
+            stop = _mm256_or_si256(_mm256_cmpeq_epi32(v, dquote), _mm256_cmpeq_epi32(v, backslash));
+        }
+        else {
+            stop = _mm256_cmpeq_epi32(v, squote);
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(stop));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 8;
+    }
+    return scan_sse2<Mode>(p, end);
+}
+
+#endif // EXOLE_TOKEN_SCAN_SIMD
+
+bool is_scan_impl_supported(ScanImpl impl)
+{
+    switch (impl) {
+    case SI_SCALAR:
+        return true;
+#ifdef EXOLE_TOKEN_SCAN_SIMD
+    case SI_SSE2:
+        return true;
+    case SI_AVX2:
+        __builtin_cpu_init(); // may be called by a static initializer
+        return __builtin_cpu_supports("avx2");
+#else
+    case SI_SSE2:
+    case SI_AVX2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+static ScanImpl fastest_scan_impl()
+{
+    if (is_scan_impl_supported(SI_AVX2))
+        return SI_AVX2;
+    if (is_scan_impl_supported(SI_SSE2))
+        return SI_SSE2;
+    return SI_SCALAR;
+}
+
+static ScanImpl scan_impl = fastest_scan_impl();
+
+bool set_scan_impl(ScanImpl impl)
+{
+    if (!is_scan_impl_supported(impl))
+        return false;
+    scan_impl = impl;
+    return true;
+}
+
+template <ScanMode Mode>
+static const wchar_t *scan(const wchar_t *p, const wchar_t *end)
+{
+    switch (scan_impl) {
+#ifdef EXOLE_TOKEN_SCAN_SIMD
+    case SI_AVX2:
+        return scan_avx2<Mode>(p, end);
+    case SI_SSE2:
+        return scan_sse2<Mode>(p, end);
+#endif
+    default:
+        return scan_scalar<Mode>(p, end);
+    }
+}
+
+const wchar_t *scan_token_run(const wchar_t *p, const wchar_t *end, ScanMode mode)
+{
+    switch (mode) {
+    case SM_NORMAL: return scan<SM_NORMAL>(p, end);
+    case SM_DQUOTE: return scan<SM_DQUOTE>(p, end);
+    case SM_SQUOTE: return scan<SM_SQUOTE>(p, end);
+    }
+    return p;
+}
+
+} // namespace detail
+} // namespace exole
@@ -0,0 +1,36 @@
+#ifndef EXOLE_TOKEN_SCAN_H
+#define EXOLE_TOKEN_SCAN_H
+
+namespace exole {
+namespace detail {
+
+enum ScanMode
+{
+    SM_NORMAL, // stops at anything but printable ASCII, and at quotes and backslashes
+    SM_DQUOTE, // stops at '"' and backslashes
+    SM_SQUOTE, // stops at '\''
+};
+
+enum ScanImpl
+{
+    SI_SCALAR,
+    SI_SSE2,
+    SI_AVX2,
+};
+
+/// Find the end of a run of characters which a token takes as they are in \a mode , so that TokenParser
+/// can copy them at once. Uses SSE2 or AVX2 if available.
+/// \return the first character in [p, end) which needs the state machine of Token, or end.
+const wchar_t *scan_token_run(const wchar_t *p, const wchar_t *end, ScanMode mode);
+
+/// Whether \a impl can run on this machine.
+bool is_scan_impl_supported(ScanImpl impl);
+/// Choose the implementation of scan_token_run(), e.g. to test each of them. The fastest one by default.
+/// Not thread-safe, call it before parsing.
+/// \return false if \a impl is not supported.
+bool set_scan_impl(ScanImpl impl);
+
+} // namespace detail
+} // namespace exole
+
+#endif // EXOLE_TOKEN_SCAN_H
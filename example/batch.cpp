@@ -3,10 +3,16 @@
 #include "file_name_completer.h"
 #include "console.h"
 #include "help_command.h"
+#include "stats_command.h"
+#include "command_stats.h"
 #include "wcs_util.h"
 #include "batch_mode_args.h"
+#include "batch_executor.h"
+#include "batch_source.h"
+#include "batch_script.h"
 #include "constant_console.h"
 #include <cstdlib>
+#include <memory>
 
 using namespace exole;
 
@@ -22,22 +28,25 @@ int main(int argc, char *argv[])
     // Batch mode options:
     //      -b: enable batch mode
     //      -x <command>: execute <command>
-    //      -f <file>: read commands from <file> and execute them
+    //      -f <file>: read commands from <file> and execute them, "-f -" reads commands from stdin
+    //                 <file> can also be compiled with example_batch_compile
+    //      -j <N>: run re-entrant commands on N worker threads, 0 for one thread per CPU core
     //
     // Example usage:
     //      ./example_batch -b -x 'const pi' -x const -x pi -f commands.txt -f more_commands.txt
+    //      ./example_batch -b -j 0 -f commands.txt
+    //      generate_commands | ./example_batch -b -f -
+    //      ./example_batch_compile commands.txt commands.bin && ./example_batch -b -f commands.bin
+    //      EXOLE_DUMP_STATS=1 ./example_batch -b -f commands.txt      (print latencies at exit, see step 5)
     BatchModeArgs args;
 
     // These options are not mandatory. Change the name to '\0' for unnecessary options.
     const char BATCH_OPT_NAME = 'b';
     const char EXEC_OPT_NAME = 'x';
     const char FILE_OPT_NAME = 'f';
+    const char JOBS_OPT_NAME = 'j';
 
-    bool ok = args.parse(argc, argv, BATCH_OPT_NAME, EXEC_OPT_NAME, FILE_OPT_NAME);
-    if (!ok) {
-        return -1;
-    }
-    ok = args.load_commands();
+    bool ok = args.parse(argc, argv, BATCH_OPT_NAME, EXEC_OPT_NAME, FILE_OPT_NAME, JOBS_OPT_NAME);
     if (!ok) {
         return -1;
     }
@@ -59,26 +68,92 @@ int main(int argc, char *argv[])
 
     app.command_manager().add_command(new ConstantConsole);
     app.command_manager().add_command(new HelpCommand);
+    app.command_manager().add_command(new StatsCommand);
 
     // 4. Run the application.
+    bool failed = false;
     if (args.batch_mode_enabled()) {
-        // In batch mode, run commands one by one.
+        // Open the files passed via '-f' before running anything, so that a missing file is reported
+        // before any command has run. A script compiled by example_batch_compile is replayed without parsing.
+        // Command files are read incrementally while running, and their lines are views into the file,
+        // converted to wide strings only when they run.
+        struct Input
+        {
+            std::unique_ptr<BatchScript> script; // a compiled script, or
+            std::unique_ptr<BatchSource> source; // a command file
+        };
+        std::vector<Input> inputs(args.files().size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            const char *file = args.files()[i];
+            if (0 != strcmp(file, "-") && BatchScript::is_compiled(file)) {
+                inputs[i].script.reset(new BatchScript);
+                ok = inputs[i].script->load(app, file);
+            }
+            else {
+                inputs[i].source.reset(new BatchSource);
+                ok = inputs[i].source->open(std::vector<const char *>{file});
+            }
+            if (!ok) {
+                return -1;
+            }
+        }
+
+        // In batch mode with '-j', run re-entrant commands in parallel.
+        // Other commands still run one by one, in order.
+        std::unique_ptr<BatchExecutor> executor;
+        if (args.jobs() != 1) {
+            executor.reset(new BatchExecutor(app, args.jobs()));
+        }
+        auto run_command = [&](const std::wstring &command) {
+            if (executor)
+                executor->run_command(command);
+            else
+                app.run_command(command);
+        };
 
         // run commands passed via '-x'
         for (auto c: args.commands()) {
-            auto command = mbs_to_wcs(c, strlen(c));
-            app.run_command(command);
+            run_command(mbs_to_wcs(c, strlen(c)));
         }
+        app.discard_partial_command(); // e.g. an unmatched quote
+
+        // run commands in files passed via '-f'
+        for (auto &input: inputs) {
+            if (input.script) {
+                if (executor)
+                    executor->finish();
+                app.run_script(*input.script);
+                continue;
+            }
 
-        // run commands loaded from files passed via '-f'
-        for (auto c: args.file_commands()) {
-            auto command = mbs_to_wcs(c);
-            app.run_command(command);
+            BatchSource &source = *input.source;
+            const char *line;
+            size_t len;
+            while (source.next(&line, &len)) {
+                // a blank line or a '#' in a quoted argument is part of the command
+                if (!app.has_partial_command() && BatchSource::is_empty_or_comment(line, len))
+                    continue;
+                run_command(mbs_to_wcs(line, len));
+            }
+            app.discard_partial_command(); // a command does not continue in the next file
+            if (source.failed()) {
+                failed = true;
+                break;
+            }
         }
+        if (executor)
+            executor->finish();
     }
     else {
         // In interactive mode, just enter the normal run loop.
         app.run();
     }
-    return 0;
+
+    // 5. Optionally print the latencies of commands. They are recorded only if exole is built with
+    //    EXOLE_ENABLE_STATS, and can also be shown with the "stats" command.
+    if (args.batch_mode_enabled() && getenv("EXOLE_DUMP_STATS") && CommandStats::enabled()) {
+        app.stats().print(app.out(), Output::ERR);
+        app.out().flush();
+    }
+    return failed ? -1 : 0;
 }
@@ -0,0 +1,37 @@
+#include "application.h"
+#include "console.h"
+#include "help_command.h"
+#include "stats_command.h"
+#include "batch_source.h"
+#include "batch_script.h"
+#include "constant_console.h"
+#include <cstdio>
+
+using namespace exole;
+
+// Compile a command file of example_batch into a script, which example_batch can replay without parsing.
+//
+// Example usage:
+//      ./example_batch_compile commands.txt commands.bin
+//      ./example_batch -b -f commands.bin
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <command file> <output file>\n", argv[0]);
+        return -1;
+    }
+
+    // Commands are resolved while compiling, so register the same commands as example_batch.
+    Application app;
+    app.init_batch_mode(argv[0], nullptr);
+    app.command_manager().add_command(new ConstantConsole);
+    app.command_manager().add_command(new HelpCommand);
+    app.command_manager().add_command(new StatsCommand);
+
+    BatchSource source;
+    std::vector<const char *> files{argv[1]};
+    if (!source.open(files)) {
+        return -1;
+    }
+    return BatchScript::compile(app, source, argv[2]) ? 0 : -1;
+}
@@ -0,0 +1,88 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const char DEFAULT_SOCKET_PATH[] = "/tmp/exole_example.sock";
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// A minimal client of example_server: send stdin to the server line by line, and print what it sends back.
+// Ctrl-D on a terminal leaves the current console of the session.
+//
+// Example usage:
+//      ./example_client /tmp/exole_example.sock
+//      printf 'const\npi\n' | ./example_client /tmp/exole_example.sock
+int main(int argc, char *argv[])
+{
+    const char *socket_path = argc > 1 ? argv[1] : DEFAULT_SOCKET_PATH;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path is too long: '%s'\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "cannot connect to '%s': %s\n", socket_path, strerror(errno));
+        return -1;
+    }
+
+    const bool is_tty = isatty(STDIN_FILENO);
+    struct pollfd fds[2] = {
+        {fd, POLLIN, 0},
+        {STDIN_FILENO, POLLIN, 0},
+    };
+    int nfds = 2;
+    char buffer[64 * 1024];
+    while (true) {
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return -1;
+        }
+        if (fds[0].revents) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0) // the server has closed the session
+                break;
+            write_all(STDOUT_FILENO, buffer, n);
+        }
+        if (nfds > 1 && fds[1].revents) {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n > 0) {
+                write_all(fd, buffer, n);
+            }
+            else if (is_tty) {
+                // Ctrl-D: leave the current console
+                write_all(fd, "\x04\n", 2);
+            }
+            else {
+                // end of input, wait for the rest of the output
+                shutdown(fd, SHUT_WR);
+                nfds = 1;
+            }
+        }
+    }
+    close(fd);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "console.h"
 #include "command.h"
+#include "output.h"
 
 namespace exole {
 
@@ -17,9 +18,11 @@ public:
     }
     void run(Application &app, int argc, const wchar_t **argv) override
     {
-        printf("%ls\n", value_.c_str());
+        out_printf("%ls\n", value_.c_str());
     }
 
+    bool is_reentrant() const override { return true; }
+
 private:
     std::wstring value_;
 };
@@ -32,10 +35,13 @@ public:
     {
         set_usage(L"const: show mathematical constants");
 
-        // ref: https://en.wikipedia.org/wiki/Mathematical_constant
-        command_manager().add_command(new ConstantCommand(L"pi", L"Archimedes' constant π", L"3.14159 26535 89793 23846 26433 83279 50288"));
-        command_manager().add_command(new ConstantCommand(L"e", L"Euler's number e", L"2.71828 18284 59045 23536 02874 71352 66249"));
-        command_manager().add_command(new ConstantCommand(L"sqrt2", L"square root of 2", L"1.41421 35623 73095 04880 16887 24209 69807"));
+        // The sub-commands are added when the console is used for the first time.
+        set_command_factory([](CommandManager &commands) {
+            // ref: https://en.wikipedia.org/wiki/Mathematical_constant
+            commands.add_command(new ConstantCommand(L"pi", L"Archimedes' constant π", L"3.14159 26535 89793 23846 26433 83279 50288"));
+            commands.add_command(new ConstantCommand(L"e", L"Euler's number e", L"2.71828 18284 59045 23536 02874 71352 66249"));
+            commands.add_command(new ConstantCommand(L"sqrt2", L"square root of 2", L"1.41421 35623 73095 04880 16887 24209 69807"));
+        });
     }
 };
 
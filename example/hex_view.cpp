@@ -3,7 +3,13 @@
 #include "file_name_completer.h"
 #include "console.h"
 #include "wcs_util.h"
+#include "output.h"
+#include "completion_sink.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
 
 using namespace exole;
 
@@ -64,11 +70,11 @@ public:
         if (argc == 1) {
             FileViewContext *context = dynamic_cast<FileViewContext *>(app.context());
             if (!context) {
-                printf("invalid context\n");
+                app.out().printf("invalid context\n");
                 return;
             }
             if (context->set_file(wcs_to_mbs(argv[0]).c_str()))
-                printf("file selected: %ls, size: %zu\n", argv[0], context->length_);
+                app.out().printf("file selected: %ls, size: %zu\n", argv[0], context->length_);
 
             // set file name as console prompt
             app.set_default_prompt(L'[' + mbs_to_wcs(basename(context->file_path_)) + L']');
@@ -87,19 +93,19 @@ public:
             const Token &token = parser.tokens()[0];
             if (token.cursor() < 0)
                 return result;
-            return transform(FileNameCompleter::complete(token.value().c_str(), token.cursor(), completion, FT_ALL_TYPES));
+            return transform(FileNameCompleter::complete(token.value_data(), token.cursor(), completion, FT_ALL_TYPES));
         }
         else {
             return result;
         }
     }
 
-    static std::vector<CompletionItem> transform(const std::vector<FileNameCompletionItem> &items)
+    static std::vector<CompletionItem> transform(std::vector<FileNameCompletionItem> items)
     {
         std::vector<CompletionItem> result;
         result.reserve(items.size());
-        for (const auto &item : items) {
-            result.push_back(CompletionItem(item.value(), item.type() != FT_DIRECTORY));
+        for (auto &item : items) {
+            result.push_back(CompletionItem(std::move(item.value()), item.type() != FT_DIRECTORY));
         }
 
         return result;
@@ -130,8 +136,9 @@ public:
         if (!context) {
             return;
         }
+        Output &out = app.out();
         if (!context->fp_) {
-            fprintf(stderr, "ERROR: file is not ready\n");
+            out.eprintf("ERROR: file is not ready\n");
             return;
         }
 
@@ -141,7 +148,7 @@ public:
         if (argc >= 1) {
             rows = atoi(wcs_to_mbs(argv[0]).c_str());
             if (rows <= 0) {
-                fprintf(stderr, "ERROR: invalid line number: '%ls'\n", argv[0]);
+                out.eprintf("ERROR: invalid line number: '%ls'\n", argv[0]);
                 return;
             }
         }
@@ -153,7 +160,7 @@ public:
                 break;
             uint64_t offset = ftell(context->fp_);
 
-            print_line(offset, buf, n);
+            print_line(out, offset, buf, n);
 
             if (n < LINE_LENGTH) { // no more lines
                 break;
@@ -162,40 +169,130 @@ public:
 
         // print progress
         uint64_t offset = ftell(context->fp_);
-        printf("-------- %llu%% -------- ", 100ull * offset / context->length_);
+        out.printf("-------- %llu%% -------- ", 100ull * offset / context->length_);
         if (offset < context->length_)
-            printf("press ENTER to continue --------\n");
+            out.printf("press ENTER to continue --------\n");
         else
-            printf("finished --------\n");
+            out.printf("finished --------\n");
     }
 
-    void print_line(uint64_t file_offset, const unsigned char *data, size_t length) const
+    void print_line(Output &out, uint64_t file_offset, const unsigned char *data, size_t length) const
     {
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        // format the whole line, then write it at once
+        char line[128];
+        size_t n = 0;
+
         // print file offset
-        printf("[%08llx]", (unsigned long long)file_offset);
+        n += snprintf(line, sizeof(line), "[%08llx]", (unsigned long long)file_offset);
 
         // print hex data
         for (size_t i = 0; i < LINE_LENGTH; i++) {
             if (i % 4 == 0)
-                printf(" ");
-            if (i < length)
-                printf(" %02x", data[i]);
-            else
-                printf("   ");
+                line[n++] = ' ';
+            line[n++] = ' ';
+            line[n++] = (i < length) ? HEX_DIGITS[data[i] >> 4] : ' ';
+            line[n++] = (i < length) ? HEX_DIGITS[data[i] & 0xf] : ' ';
         }
 
-        printf("  -  ");
+        memcpy(line + n, "  -  ", 5);
+        n += 5;
 
         // print as text
         for (size_t i = 0; i < length; i++) {
             if (data[i] >= 32 && data[i] <127 && isprint(data[i]))
-                printf("%c", data[i]);
+                line[n++] = data[i];
             else
-                printf(".");
+                line[n++] = '.';
+        }
+
+        line[n++] = '\n';
+        out.write(Output::OUT, line, n);
+    }
+};
+
+class HexGotoCommand: public Command
+{
+public:
+    HexGotoCommand()
+    : Command(L"goto")
+    {
+        set_usage(L"goto <offset>: move to a line, e.g. \"goto 00001f40\", try <tab> for offsets");
+    }
+    void run(Application &app, int argc, const wchar_t **argv) override
+    {
+        FileViewContext *context = dynamic_cast<FileViewContext *>(app.context());
+        if (!context || !context->fp_) {
+            app.out().eprintf("ERROR: file is not ready\n");
+            return;
+        }
+        wchar_t *end = nullptr;
+        unsigned long long offset = (argc == 1) ? wcstoull(argv[0], &end, 16) : 0;
+        if (argc != 1 || *end != L'\0' || offset >= context->length_) {
+            app.out().eprintf("ERROR: invalid offset\n");
+            return;
+        }
+        offset -= offset % HexNextCommand::LINE_LENGTH;
+        fseek(context->fp_, offset, SEEK_SET);
+        app.out().printf("moved to %08llx\n", offset);
+    }
+
+    // A large file has millions of lines, so the offsets are streamed rather than returned in a vector.
+    // The sink keeps the first ones and counts the rest.
+    void stream_complete(Application &app, const wchar_t *line, size_t len, const wchar_t *cursor, CompletionSink &sink) override
+    {
+        FileViewContext *context = dynamic_cast<FileViewContext *>(app.context());
+        if (!context || !context->fp_) {
+            return;
+        }
+        TokenParser parser;
+        parser.parse(line, len, cursor);
+        if (parser.get_cursor_info().token_index != 0) {
+            return;
+        }
+        // The console has set the prefix of the sink to the token at the cursor.
+        const std::wstring &prefix = parser.get_cursor_info().prefix;
+        if (prefix.size() > MAX_DIGITS) {
+            return;
+        }
+        uint64_t base = 0; // the prefix as a number
+        for (wchar_t c : prefix) {
+            if (!iswxdigit(c)) {
+                return;
+            }
+            base = base * 16 + (iswdigit(c) ? c - L'0' : towlower(c) - L'a' + 10);
         }
 
-        printf("\n");
+        // Offsets are shown with 8 digits at least, so the ones starting with the prefix make a range
+        // for each number of digits.
+        const uint64_t step = HexNextCommand::LINE_LENGTH;
+        wchar_t buf[32];
+        std::wstring value;
+        for (size_t digits = 8; digits <= MAX_DIGITS; digits++) {
+            uint64_t lower = (digits == 8) ? 0 : uint64_t(1) << (4 * (digits - 1));
+            uint64_t upper = uint64_t(1) << (4 * digits);
+            if (lower >= context->length_) {
+                break;
+            }
+            if (prefix.size() > digits) {
+                continue;
+            }
+            uint64_t scale = uint64_t(1) << (4 * (digits - prefix.size()));
+            uint64_t begin = std::max(lower, base * scale);
+            uint64_t end = std::min(std::min(upper, (base + 1) * scale), uint64_t(context->length_));
+            for (uint64_t offset = (begin + step - 1) / step * step; offset < end; offset += step) {
+                swprintf(buf, sizeof(buf) / sizeof(buf[0]), L"%08llx", (unsigned long long)offset);
+                value.assign(buf);
+                if (!sink.add(value, true) || Application::completion_cancelled()) {
+                    sink.stop();
+                    return;
+                }
+            }
+        }
     }
+
+private:
+    static const size_t MAX_DIGITS = 15;
 };
 
 class HexView: public Console
@@ -205,7 +302,10 @@ public:
     : Console(L"hex")
     {
         set_usage(L"hex:  view hex data");
-        command_manager().add_command(new HexNextCommand);
+        set_command_factory([](CommandManager &commands) {
+            commands.add_command(new HexNextCommand);
+            commands.add_command(new HexGotoCommand);
+        });
     }
     void on_enter_console(Application &app) override
     {
@@ -220,6 +320,7 @@ int main(int argc, char *argv[])
     Application app;
     auto context = std::make_unique<FileViewContext>();
     app.init(argv[0], std::move(context), HISTORY_FILE);
+    app.set_completion_deadline(500); // listing a directory on a network mount may be slow
     app.command_manager().add_command(new FileCommand);
     app.command_manager().add_command(new HexView);
     app.run();
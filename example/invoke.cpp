@@ -0,0 +1,41 @@
+#include "application.h"
+#include "help_command.h"
+#include "constant_console.h"
+#include <cstdlib>
+
+using namespace exole;
+
+// Drive commands from code: resolve a command path once, then invoke it directly.
+//
+// Example usage:
+//      ./example_invoke 1000000 > /dev/null
+int main(int argc, char *argv[])
+{
+    Application app;
+    app.init_batch_mode(argv[0], nullptr);
+    app.command_manager().add_command(new ConstantConsole);
+    app.command_manager().add_command(new HelpCommand);
+
+    long count = (argc > 1) ? atol(argv[1]) : 1;
+
+    CommandHandle pi;
+    CommandStatus status = app.resolve_command({L"const", L"pi"}, &pi);
+    if (status != CS_OK) {
+        fprintf(stderr, "cannot resolve command: %d\n", status);
+        return -1;
+    }
+    for (long i = 0; i < count; i++) {
+        app.invoke(pi, 0, nullptr);
+    }
+
+    // Arguments are passed as if they were typed after the command path, e.g. "help const".
+    CommandHandle help;
+    app.resolve_command({L"help"}, &help);
+    const wchar_t *help_args[] = {L"const"};
+    app.invoke(help, 1, help_args);
+
+    CommandHandle missing;
+    status = app.resolve_command({L"const", L"tau"}, &missing);
+    printf("resolve const tau: %s\n", status == CS_NOT_FOUND ? "not found" : "found");
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "application.h"
+#include "command.h"
+#include "console.h"
+#include "help_command.h"
+#include "job_commands.h"
+#include "job_table.h"
+#include "output.h"
+#include <chrono>
+#include <cwchar>
+#include <thread>
+
+using namespace exole;
+
+const char HISTORY_FILE[]=".example_jobs_history";
+
+// A long running command, which can run in the background like "sleep 10 &".
+class SleepCommand: public Command
+{
+public:
+    SleepCommand()
+    : Command(L"sleep")
+    {
+        set_usage(L"sleep <seconds>: sleep for a while, try \"sleep 10 &\"");
+    }
+    void run(Application &app, int argc, const wchar_t **argv) override
+    {
+        if (argc != 1) {
+            app.out().eprintf("ERROR: invalid arguments\n");
+            return;
+        }
+        long ms = wcstol(argv[0], nullptr, 10) * 1000;
+        // check whether the job has been killed from time to time
+        for (long i = 0; i < ms && !JobTable::cancelled(); i += 100) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        app.out().printf("slept %ls seconds%s\n", argv[0], JobTable::cancelled() ? ", but was killed" : "");
+    }
+
+    // Only re-entrant commands can run in the background.
+    bool is_reentrant() const override { return true; }
+};
+
+int main(int argc, char *argv[])
+{
+    Application app;
+    app.init(argv[0], nullptr, HISTORY_FILE);
+    app.command_manager().add_command(new SleepCommand);
+    app.command_manager().add_command(new JobsCommand);
+    app.command_manager().add_command(new WaitCommand);
+    app.command_manager().add_command(new KillCommand);
+    app.command_manager().add_command(new HelpCommand);
+    app.run();
+    return 0;
+}
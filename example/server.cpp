@@ -0,0 +1,84 @@
+#include "application.h"
+#include "command.h"
+#include "command_context.h"
+#include "console.h"
+#include "help_command.h"
+#include "stats_command.h"
+#include "output.h"
+#include "constant_console.h"
+#include <memory>
+
+using namespace exole;
+
+const char DEFAULT_SOCKET_PATH[] = "/tmp/exole_example.sock";
+
+// Each session has its own context.
+class SessionContext: public CommandContext
+{
+public:
+    explicit SessionContext(int id)
+    : id_(id)
+    , num_commands_(0)
+    {}
+    int id_;
+    int num_commands_;
+};
+
+class WhoamiCommand: public Command
+{
+public:
+    WhoamiCommand()
+    : Command(L"whoami")
+    {
+        set_usage(L"whoami: show the session id, and how many times this command has run in the session");
+    }
+    void run(Application &app, int /*argc*/, const wchar_t ** /*argv*/) override
+    {
+        SessionContext *context = dynamic_cast<SessionContext *>(app.context());
+        if (!context) {
+            app.out().eprintf("invalid context\n");
+            return;
+        }
+        context->num_commands_++;
+        app.out().printf("session %d, whoami #%d\n", context->id_, context->num_commands_);
+    }
+};
+
+class ShutdownCommand: public Command
+{
+public:
+    ShutdownCommand()
+    : Command(L"shutdown")
+    {
+        set_usage(L"shutdown: stop the server");
+    }
+    void run(Application &app, int /*argc*/, const wchar_t ** /*argv*/) override
+    {
+        app.out().printf("shutting down\n");
+        app.stop_serving();
+    }
+};
+
+// Serve console sessions on a Unix domain socket. Connect with example_client.
+//
+// Example usage:
+//      ./example_server /tmp/exole_example.sock &
+//      ./example_client /tmp/exole_example.sock
+int main(int argc, char *argv[])
+{
+    const char *socket_path = argc > 1 ? argv[1] : DEFAULT_SOCKET_PATH;
+
+    // The commands are shared by all sessions.
+    Application app;
+    app.command_manager().add_command(new ConstantConsole);
+    app.command_manager().add_command(new HelpCommand);
+    app.command_manager().add_command(new StatsCommand);
+    app.command_manager().add_command(new WhoamiCommand);
+    app.command_manager().add_command(new ShutdownCommand);
+
+    int num_sessions = 0;
+    bool ok = app.serve(socket_path, [&num_sessions]() {
+        return std::unique_ptr<CommandContext>(new SessionContext(++num_sessions));
+    });
+    return ok ? 0 : -1;
+}
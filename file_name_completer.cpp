@@ -1,42 +1,28 @@
 #include "file_name_completer.h"
 #include "wcs_util.h"
-#include <dirent.h>
-#include <cstring>
+#include "detail/dir_cache.h"
 
 namespace exole {
 
+static const size_t DIR_CACHE_CAPACITY = 64; // directories
+
 std::vector<FileNameCompletionItem> FileNameCompleter::list_files(const std::string &dir_name, int types)
 {
-    DIR *dir;
-    struct dirent *ent;
-    if ((dir = opendir (dir_name.c_str())) != NULL) {
-        std::vector<FileNameCompletionItem> result;
-        while ((ent = readdir (dir)) != NULL) {
-            FileType type = FT_UNKNOWN;
-            switch (ent->d_type) {
-            case DT_REG: type = FT_REGULAR_FILE; break;
-            case DT_DIR: type = FT_DIRECTORY; break;
-            }
-            if ((type & types) == 0) {
-                continue;
-            }
-            // TODO: handle other file types
-
-            if (0 == strcmp(".", ent->d_name) || 0 == strcmp("..", ent->d_name)) {
-                continue;
-            }
-            std::wstring name = mbs_to_wcs(ent->d_name);
-            if (type == FT_DIRECTORY) {
-                name += '/';
-            }
-            result.push_back(FileNameCompletionItem(name, type));
-        }
-        closedir (dir);
-        return result;
-    } else {
+    std::vector<detail::DirCache::Entry> entries;
+    std::vector<FileNameCompletionItem> result;
+    if (!detail::DirCache::list(dir_name, "", types, entries)) {
         /* could not open directory */
-        return std::vector<FileNameCompletionItem>();
+        return result;
+    }
+    result.reserve(entries.size());
+    for (const auto &entry : entries) {
+        std::wstring name = mbs_to_wcs(entry.name);
+        if (entry.type == FT_DIRECTORY) {
+            name += '/';
+        }
+        result.push_back(FileNameCompletionItem(std::move(name), entry.type));
     }
+    return result;
 }
 
 std::vector<FileNameCompletionItem> FileNameCompleter::complete(const wchar_t *token, size_t len, std::wstring &completion, int types)
@@ -46,11 +32,30 @@ std::vector<FileNameCompletionItem> FileNameCompleter::complete(const wchar_t *t
 
     std::string dir_name = (sep != mbs_token.npos) ? mbs_token.substr(0, sep+1) : "./";
     std::string file_prefix = (sep != mbs_token.npos) ? mbs_token.substr(sep+1) : mbs_token;
-    auto candidates = list_files(dir_name, types);
+    completion.clear();
+
+    // Listing a huge directory on every Tab is slow, so the listings are cached.
+    static detail::DirCache cache(DIR_CACHE_CAPACITY);
+    std::vector<detail::DirCache::Entry> entries;
+    if (!cache.match(dir_name, file_prefix, types, entries)) {
+        return std::vector<FileNameCompletionItem>();
+    }
+    std::vector<FileNameCompletionItem> result;
+    result.reserve(entries.size());
+    std::wstring max_common_prefix;
+    for (const auto &entry : entries) {
+        std::wstring name = mbs_to_wcs(entry.name);
+        if (entry.type == FT_DIRECTORY) {
+            name += '/';
+        }
+        max_common_prefix = result.empty() ? name : common_prefix(max_common_prefix, name);
+        result.push_back(FileNameCompletionItem(std::move(name), entry.type));
+    }
     std::wstring prefix = mbs_to_wcs(file_prefix);
-    return match_by_prefix(candidates,
-            [](const FileNameCompletionItem &item) { return item.value(); },
-            prefix, completion);
+    if (!result.empty() && max_common_prefix.size() >= prefix.size()) {
+        completion = max_common_prefix.substr(prefix.size());
+    }
+    return result;
 }
 
 } // namespace exole
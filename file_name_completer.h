@@ -2,6 +2,7 @@
 #define EXOLE_FILE_NAME_COMPLETER_H
 
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace exole {
@@ -20,8 +21,14 @@ public:
     : value_(value)
     , type_(type)
     {}
+    FileNameCompletionItem(std::wstring &&value, FileType type)
+    : value_(std::move(value))
+    , type_(type)
+    {}
 
     const std::wstring &value() const { return value_; }
+    /// For moving the value into another item.
+    std::wstring &value() { return value_; }
     FileType type() const { return type_; }
 private:
     std::wstring value_;
@@ -31,6 +38,7 @@ private:
 class FileNameCompleter
 {
 public:
+    /// Complete a file name. The listings of recently completed directories are cached.
     static std::vector<FileNameCompletionItem> complete(const wchar_t *token, size_t len, std::wstring &completion, int types = FT_ALL_TYPES);
     static std::vector<FileNameCompletionItem> list_files(const std::string &dir_name, int types = FT_ALL_TYPES);
 };
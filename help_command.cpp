@@ -21,18 +21,17 @@ void HelpCommand::run(Application &app, int argc, const wchar_t **argv)
     // Example: "help c1 c2 c3 c4", finally *console* points to c3 and *sub_cmd* points to c4.
     Console *console = app.current_console();
     Command *sub_cmd = nullptr;
-    std::wstring arg;
     while (argc > 0) {
-        arg = argv[0];
+        const wchar_t *arg = argv[0];
         sub_cmd = console->command_manager().find_command(arg);
         if (sub_cmd == nullptr) {
-            fprintf(stderr, "ERROR: command '%ls' not found\n", arg.c_str());
+            app.out().eprintf("ERROR: command '%ls' not found\n", arg);
             return;
         }
         if (argc > 1) {
             Console *sub_console = dynamic_cast<Console *>(sub_cmd);
             if (sub_console == nullptr) {
-                fprintf(stderr, "ERROR: command '%ls' has no sub commands\n", arg.c_str());
+                app.out().eprintf("ERROR: command '%ls' has no sub commands\n", arg);
                 return;
             }
             console = sub_console;
@@ -42,7 +41,7 @@ void HelpCommand::run(Application &app, int argc, const wchar_t **argv)
     }
 
     std::wstring usage = sub_cmd->usage();
-    printf("%ls\n", usage.c_str());
+    app.out().printf("%ls\n", usage.c_str());
 
     Console *sub_console = dynamic_cast<Console *>(sub_cmd);
     if (sub_console != nullptr) {
@@ -63,10 +62,9 @@ std::vector<CompletionItem> HelpCommand::auto_complete(Application & app,
     //                    ^
     //                 cursor
     Console *console = app.current_console();
-    std::wstring arg;
     for (size_t i = 0; i < cursor_info.token_index; i++) {
         const Token &tok = parser.tokens()[i];
-        Command *sub_cmd = console->command_manager().find_command(tok.value());
+        Command *sub_cmd = console->command_manager().find_command(tok.value_data(), tok.value_size());
         if (sub_cmd == nullptr) { // command not found
             return result;
         }
@@ -80,7 +78,7 @@ std::vector<CompletionItem> HelpCommand::auto_complete(Application & app,
     if (!commands.empty()) {
         result.reserve(commands.size());
         for (auto c : commands) {
-            result.push_back(CompletionItem(c->name(), true));
+            result.push_back(CompletionItem::borrow(c->name(), true));
         }
     }
     return result;
@@ -13,6 +13,7 @@ public:
 
     std::vector<CompletionItem> auto_complete(Application & app,
             const wchar_t *line, size_t len, const wchar_t *cursor, std::wstring &completion) override;
+    bool is_completion_narrowable() const override { return true; }
 };
 
 } // namespace exole
@@ -0,0 +1,70 @@
+#include "job_commands.h"
+#include "application.h"
+#include "job_table.h"
+#include <cwchar>
+
+namespace exole {
+
+/// \return the job id in \a arg , or 0 if it is invalid.
+static int parse_job_id(const wchar_t *arg)
+{
+    if (arg[0] == L'%') // like "%1" in shells
+        arg++;
+    wchar_t *end = nullptr;
+    long id = wcstol(arg, &end, 10);
+    return (end != arg && *end == L'\0' && id > 0 && id <= 0x7fffffff) ? int(id) : 0;
+}
+
+JobsCommand::JobsCommand(const std::wstring &name)
+: Command(name)
+{
+    set_usage(L"jobs: list background jobs, which are started like \"command &\"");
+}
+
+void JobsCommand::run(Application &app, int /*argc*/, const wchar_t ** /*argv*/)
+{
+    static const char *STATE_NAMES[] = {"Running", "Done", "Killed"};
+    for (const auto &job : app.jobs().list()) {
+        app.out().printf("[%d] %-8s %ls\n", job.id, STATE_NAMES[job.state], job.command_line.c_str());
+    }
+}
+
+WaitCommand::WaitCommand(const std::wstring &name)
+: Command(name)
+{
+    set_usage(L"wait [job id]: wait for a background job, or all of them");
+}
+
+void WaitCommand::run(Application &app, int argc, const wchar_t **argv)
+{
+    int id = 0;
+    if (argc > 1 || (argc == 1 && 0 == (id = parse_job_id(argv[0])))) {
+        app.out().eprintf("ERROR: invalid arguments\n");
+        return;
+    }
+    if (!app.jobs().wait(id)) {
+        app.out().eprintf("ERROR: no such job: %ls\n", argv[0]);
+        return;
+    }
+    app.jobs().report(app.out());
+}
+
+KillCommand::KillCommand(const std::wstring &name)
+: Command(name)
+{
+    set_usage(L"kill <job id>: stop a background job");
+}
+
+void KillCommand::run(Application &app, int argc, const wchar_t **argv)
+{
+    int id = 0;
+    if (argc != 1 || 0 == (id = parse_job_id(argv[0]))) {
+        app.out().eprintf("ERROR: invalid arguments\n");
+        return;
+    }
+    if (!app.jobs().kill(id)) {
+        app.out().eprintf("ERROR: no such running job: %ls\n", argv[0]);
+    }
+}
+
+} // namespace exole
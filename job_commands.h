@@ -0,0 +1,34 @@
+#ifndef EXOLE_JOB_COMMANDS_H
+#define EXOLE_JOB_COMMANDS_H
+
+#include "command.h"
+
+namespace exole {
+
+/// Lists the background jobs in Application::jobs().
+class JobsCommand : public Command
+{
+public:
+    JobsCommand(const std::wstring &name = L"jobs");
+    void run(Application &app, int argc, const wchar_t **argv) override;
+};
+
+/// Waits for a background job, or all of them, and prints their output.
+class WaitCommand : public Command
+{
+public:
+    WaitCommand(const std::wstring &name = L"wait");
+    void run(Application &app, int argc, const wchar_t **argv) override;
+};
+
+/// Asks a background job to stop, see JobTable::kill().
+class KillCommand : public Command
+{
+public:
+    KillCommand(const std::wstring &name = L"kill");
+    void run(Application &app, int argc, const wchar_t **argv) override;
+};
+
+} // namespace exole
+
+#endif // EXOLE_JOB_COMMANDS_H
@@ -0,0 +1,177 @@
+#include "job_table.h"
+#include "application.h"
+#include "command_stats.h"
+#include "console.h"
+#include "output.h"
+#include "detail/stats_timer.h"
+#include "detail/thread_pool.h"
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace exole {
+
+struct JobTable::Job
+{
+    int id;
+    std::wstring command_line;
+    Console *parent;
+    Command *command;
+    std::vector<std::wstring> args;
+    Output output;
+    std::atomic<bool> cancelled;
+    bool done;
+
+    Job(int job_id, const std::wstring &line, Console *console, Command *cmd, int argc, const wchar_t **argv)
+    : id(job_id)
+    , command_line(line)
+    , parent(console)
+    , command(cmd)
+    , args(argv, argv + argc)
+    , cancelled(false)
+    , done(false)
+    {}
+};
+
+static thread_local const std::atomic<bool> *current_cancelled = nullptr;
+
+JobTable::JobTable()
+{
+    if (::pipe2(notify_pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        notify_pipe_[0] = notify_pipe_[1] = -1;
+    }
+}
+
+JobTable::~JobTable()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &item : jobs_) {
+            item.second->cancelled = true;
+        }
+    }
+    pool_.reset(); // joins the workers
+    for (int fd : notify_pipe_) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+}
+
+int JobTable::start(Application &app, Console *parent, Command *command, int argc, const wchar_t **argv,
+                    const std::wstring &command_line)
+{
+    if (!pool_) {
+        pool_.reset(new detail::ThreadPool(std::thread::hardware_concurrency()));
+    }
+
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int id = jobs_.empty() ? 1 : jobs_.rbegin()->first + 1;
+        job = std::make_shared<Job>(id, command_line, parent, command, argc, argv);
+        jobs_[id] = job;
+    }
+
+    pool_->submit([this, &app, job] {
+        if (!job->cancelled) { // not killed before it starts
+            std::vector<const wchar_t *> args;
+            args.reserve(job->args.size() + 1);
+            for (const auto &a : job->args) {
+                args.push_back(a.c_str());
+            }
+            args.push_back(nullptr);
+            Output *old_output = Output::set_current(&job->output);
+            current_cancelled = &job->cancelled;
+            {
+                EXOLE_STATS_TIME(app.stats().entry(job->parent, job->command)->run);
+                job->command->run(app, job->args.size(), args.data());
+            }
+            current_cancelled = nullptr;
+            Output::set_current(old_output);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->done = true;
+        done_cond_.notify_all();
+        if (notify_pipe_[1] >= 0) {
+            char c = 0;
+            ssize_t n = ::write(notify_pipe_[1], &c, 1); // a full pipe is already readable
+            (void)n;
+        }
+    });
+    return job->id;
+}
+
+std::vector<JobTable::JobInfo> JobTable::list() const
+{
+    std::vector<JobInfo> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    result.reserve(jobs_.size());
+    for (const auto &item : jobs_) {
+        const Job &job = *item.second;
+        JobState state = !job.done ? JS_RUNNING : (job.cancelled ? JS_KILLED : JS_DONE);
+        result.push_back(JobInfo{job.id, job.command_line, state});
+    }
+    return result;
+}
+
+bool JobTable::wait(int id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (id != 0) {
+        auto it = jobs_.find(id);
+        if (it == jobs_.end()) {
+            return false;
+        }
+        std::shared_ptr<Job> job = it->second;
+        done_cond_.wait(lock, [&job] { return job->done; });
+        return true;
+    }
+    done_cond_.wait(lock, [this] {
+        for (const auto &item : jobs_) {
+            if (!item.second->done)
+                return false;
+        }
+        return true;
+    });
+    return true;
+}
+
+bool JobTable::kill(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || it->second->done) {
+        return false;
+    }
+    it->second->cancelled = true;
+    return true;
+}
+
+void JobTable::report(Output &out)
+{
+    char buf[64];
+    while (notify_pipe_[0] >= 0 && ::read(notify_pipe_[0], buf, sizeof(buf)) > 0) {
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = jobs_.begin(); it != jobs_.end(); ) {
+        Job &job = *it->second;
+        if (!job.done) {
+            ++it;
+            continue;
+        }
+        out.append(job.output);
+        job.output.clear();
+        out.printf("[%d] %s  %ls\n", job.id, job.cancelled ? "Killed" : "Done", job.command_line.c_str());
+        it = jobs_.erase(it);
+    }
+}
+
+bool JobTable::cancelled()
+{
+    return current_cancelled && current_cancelled->load();
+}
+
+} // namespace exole
@@ -0,0 +1,85 @@
+#ifndef EXOLE_JOB_TABLE_H
+#define EXOLE_JOB_TABLE_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace exole {
+
+class Application;
+class Command;
+class Console;
+class Output;
+
+namespace detail { class ThreadPool; }
+
+/**
+ * JobTable runs commands in the background on worker threads, for input like "scan /data &" in
+ * interactive mode (see Application::run()). Only re-entrant commands (see Command::is_reentrant())
+ * can run in the background.
+ *
+ * The output of a job is buffered, and printed above the prompt when the job finishes.
+ * Use JobsCommand, WaitCommand and KillCommand to manage the jobs.
+ */
+class JobTable
+{
+public:
+    enum JobState {
+        JS_RUNNING,
+        JS_DONE,
+        JS_KILLED, // finished after kill()
+    };
+    struct JobInfo
+    {
+        int id;
+        std::wstring command_line;
+        JobState state;
+    };
+
+    JobTable();
+    /// Kills the jobs and waits for them.
+    ~JobTable();
+
+    /// Run \a command of \a parent with the arguments on a worker thread.
+    /// \return the id of the job.
+    int start(Application &app, Console *parent, Command *command, int argc, const wchar_t **argv,
+              const std::wstring &command_line);
+
+    /// The jobs which have not been reported, in the order of ids.
+    std::vector<JobInfo> list() const;
+
+    /// Wait for a job, or for all jobs if \a id is 0.
+    /// \return false if there is no such job.
+    bool wait(int id);
+
+    /// Ask a job to stop. A job stops only when its command checks cancelled().
+    /// \return false if there is no such running job.
+    bool kill(int id);
+
+    /// Print the output and status of finished jobs, and remove them from the table.
+    void report(Output &out);
+
+    /// A file descriptor which becomes readable when a job finishes, until report() is called.
+    int notify_fd() const { return notify_pipe_[0]; }
+
+    /// \return true if the job running on the calling thread has been killed.
+    /// Long running commands should check it and return early.
+    static bool cancelled();
+
+private:
+    struct Job;
+
+    std::map<int, std::shared_ptr<Job>> jobs_;
+    std::unique_ptr<detail::ThreadPool> pool_;
+    mutable std::mutex mutex_;
+    std::condition_variable done_cond_;
+    int notify_pipe_[2];
+};
+
+} // namespace exole
+
+#endif // EXOLE_JOB_TABLE_H
@@ -0,0 +1,202 @@
+#include "output.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace exole {
+
+static thread_local Output *current_output = nullptr;
+
+Output::Output()
+{
+    fds_[OUT] = STDOUT_FILENO;
+    fds_[ERR] = STDERR_FILENO;
+    capture_[OUT] = capture_[ERR] = nullptr;
+}
+
+Output::~Output()
+{
+    flush();
+}
+
+void Output::append(Stream stream, const char *data, size_t len)
+{
+    if (len == 0)
+        return;
+    if (chunks_.empty() || chunks_.back().stream != stream) {
+        chunks_.push_back(Chunk{stream, data_.size(), data_.size()});
+    }
+    data_.append(data, len);
+    chunks_.back().end = data_.size();
+}
+
+void Output::write(Stream stream, const char *data, size_t len)
+{
+    append(stream, data, len);
+}
+
+void Output::put(Stream stream, char c)
+{
+    append(stream, &c, 1);
+}
+
+void Output::append(const Output &other)
+{
+    for (const Chunk &chunk : other.chunks_) {
+        append(chunk.stream, other.data_.data() + chunk.begin, chunk.end - chunk.begin);
+    }
+}
+
+int Output::vprintf(Stream stream, const char *format, va_list args)
+{
+    // Most outputs fit in a buffer on the stack. A longer one is formatted into the end of data_,
+    // which grows only by its size.
+    char buf[256];
+    va_list args2;
+    va_copy(args2, args);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    if (n > 0 && size_t(n) < sizeof(buf)) {
+        append(stream, buf, n);
+    }
+    else if (n > 0) {
+        size_t old_size = data_.size();
+        data_.resize(old_size + n + 1);
+        vsnprintf(&data_[old_size], n + 1, format, args2);
+        data_.resize(old_size + n);
+        if (chunks_.empty() || chunks_.back().stream != stream) {
+            chunks_.push_back(Chunk{stream, old_size, old_size});
+        }
+        chunks_.back().end = data_.size();
+    }
+    va_end(args2);
+    return n;
+}
+
+int Output::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(OUT, format, args);
+    va_end(args);
+    return n;
+}
+
+int Output::eprintf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(ERR, format, args);
+    va_end(args);
+    return n;
+}
+
+static void write_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0) {
+        ssize_t n = ::writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return; // nothing sensible to do, e.g. the reader has gone
+        }
+        // skip what has been written
+        while (count > 0 && size_t(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+void Output::flush()
+{
+    if (chunks_.empty())
+        return;
+    fflush(stdout);
+    fflush(stderr);
+
+    std::vector<struct iovec> iov;
+    iov.reserve(chunks_.size());
+    int fd = -1;
+    for (const Chunk &chunk : chunks_) {
+        if (capture_[chunk.stream]) {
+            capture_[chunk.stream]->append(data_, chunk.begin, chunk.end - chunk.begin);
+            continue;
+        }
+        // chunks of different streams can share a file descriptor, e.g. a socket
+        if (fds_[chunk.stream] != fd || iov.size() == IOV_MAX) {
+            write_all(fd, iov.data(), iov.size());
+            iov.clear();
+            fd = fds_[chunk.stream];
+        }
+        iov.push_back(iovec{&data_[chunk.begin], chunk.end - chunk.begin});
+    }
+    write_all(fd, iov.data(), iov.size());
+    clear();
+}
+
+void Output::clear()
+{
+    data_.clear();
+    chunks_.clear();
+}
+
+void Output::set_fds(int out_fd, int err_fd)
+{
+    flush();
+    fds_[OUT] = out_fd;
+    fds_[ERR] = err_fd;
+}
+
+void Output::set_capture(std::string *out, std::string *err)
+{
+    flush();
+    capture_[OUT] = out;
+    capture_[ERR] = err;
+}
+
+Output *Output::current()
+{
+    return current_output;
+}
+
+Output *Output::set_current(Output *output)
+{
+    Output *old = current_output;
+    current_output = output;
+    return old;
+}
+
+static int vprint(Output::Stream stream, const char *format, va_list args)
+{
+    Output *output = Output::current();
+    if (output)
+        return output->vprintf(stream, format, args);
+    return vfprintf(stream == Output::OUT ? stdout : stderr, format, args);
+}
+
+int out_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprint(Output::OUT, format, args);
+    va_end(args);
+    return n;
+}
+
+int err_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprint(Output::ERR, format, args);
+    va_end(args);
+    return n;
+}
+
+} // namespace exole
@@ -0,0 +1,80 @@
+#ifndef EXOLE_OUTPUT_H
+#define EXOLE_OUTPUT_H
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace exole {
+
+/**
+ * Output buffers what a command prints, and writes it out with as few system calls as possible
+ * when flush() is called. Application flushes its output after each command.
+ *
+ * Commands get the output with Application::out(). They can switch from printf() incrementally,
+ * but output written with stdio within the same command comes before the buffered output.
+ */
+class Output
+{
+public:
+    enum Stream {
+        OUT,
+        ERR,
+    };
+
+    Output();
+    ~Output();
+
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    int eprintf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    int vprintf(Stream stream, const char *format, va_list args);
+    void write(Stream stream, const char *data, size_t len);
+    void write(Stream stream, const std::string &data) { write(stream, data.data(), data.size()); }
+    void put(Stream stream, char c);
+    /// Append the buffered output of \a other , e.g. of a command which ran on another thread.
+    void append(const Output &other);
+
+    /// Write the buffered output in the order it was written, with one writev() per file descriptor run.
+    /// stdio buffers are flushed first.
+    void flush();
+
+    bool empty() const { return chunks_.empty(); }
+    /// Discard the buffered output.
+    void clear();
+
+    /// Set the file descriptors to write to, STDOUT_FILENO and STDERR_FILENO by default.
+    void set_fds(int out_fd, int err_fd);
+
+    /// Append the output to strings instead of writing it, nullptr to stop capturing.
+    void set_capture(std::string *out, std::string *err);
+
+    /// The output installed for the calling thread, nullptr if there is none.
+    static Output *current();
+    /// Install \a output for the calling thread, nullptr to remove it.
+    /// \return the previous one.
+    static Output *set_current(Output *output);
+
+private:
+    struct Chunk
+    {
+        Stream stream;
+        size_t begin; // range in data_
+        size_t end;
+    };
+    void append(Stream stream, const char *data, size_t len);
+
+    std::string data_;
+    std::vector<Chunk> chunks_;
+    int fds_[2];
+    std::string *capture_[2];
+};
+
+/// printf() replacements for commands that may run on a worker thread (see Command::is_reentrant()).
+/// The output goes to Output::current() if there is one, otherwise to stdout/stderr.
+int out_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+int err_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+} // namespace exole
+
+#endif // EXOLE_OUTPUT_H
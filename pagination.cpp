@@ -18,7 +18,9 @@ bool Pagination::next_page(Application &app)
     if (app.is_batch_mode()) {
         return true;
     }
-    printf("(ENTER:continue / q:quit)");
+    Output &out = app.out();
+    out.printf("(ENTER:continue / q:quit)");
+    out.flush();
     wchar_t ch = 0;
     enum { INVALID, QUIT, CONTINUE } choice = INVALID;
     const wchar_t KEY_q = 'q';
@@ -27,14 +29,18 @@ bool Pagination::next_page(Application &app)
     // choose to continue or to stop
     do {
         int num = app.getc(&ch);
-        if (num == 1) {
+        if (num < 0) { // cannot read from the terminal, e.g. in server mode
+            choice = CONTINUE;
+            out.put(Output::OUT, '\n');
+        }
+        else if (num == 1) {
             if (ch == KEY_q|| ch == KEY_Q) {
                 choice = QUIT;
-                printf("\n");
+                out.put(Output::OUT, '\n');
             }
             else if (ch == KEY_ENTER) {
                 choice = CONTINUE;
-                printf("\r");
+                out.put(Output::OUT, '\r');
             }
         }
     } while (choice == INVALID);
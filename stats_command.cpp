@@ -0,0 +1,31 @@
+#include "stats_command.h"
+#include "application.h"
+#include "command_stats.h"
+#include <cwchar>
+
+namespace exole {
+
+StatsCommand::StatsCommand(const std::wstring &name)
+: Command(name)
+{
+    set_usage(L"stats [clear]: show call counts and latencies of commands");
+}
+
+void StatsCommand::run(Application &app, int argc, const wchar_t **argv)
+{
+    if (!CommandStats::enabled()) {
+        app.out().eprintf("ERROR: statistics are disabled, build with EXOLE_ENABLE_STATS to enable them\n");
+        return;
+    }
+    if (argc == 0) {
+        app.stats().print(app.out());
+    }
+    else if (argc == 1 && 0 == wcscmp(argv[0], L"clear")) {
+        app.stats().clear();
+    }
+    else {
+        app.out().eprintf("ERROR: invalid arguments\n");
+    }
+}
+
+} // namespace exole
@@ -0,0 +1,18 @@
+#ifndef EXOLE_STATS_COMMAND_H
+#define EXOLE_STATS_COMMAND_H
+
+#include "command.h"
+
+namespace exole {
+
+/// Shows the call counts and latencies recorded in Application::stats().
+class StatsCommand : public Command
+{
+public:
+    StatsCommand(const std::wstring &name = L"stats");
+    void run(Application &app, int argc, const wchar_t **argv) override;
+};
+
+} // namespace exole
+
+#endif // EXOLE_STATS_COMMAND_H
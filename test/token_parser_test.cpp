@@ -0,0 +1,306 @@
+// Differential test of TokenParser: tokenizes random lines with each implementation of detail::scan_token_run(),
+// and compares the tokens and the cursor info with those made by pushing every character to Token::push().
+// Tokens kept by reparse() after random edits, and those taken from a shared parser, are checked the same way.
+#include "token_parser.h"
+#include "detail/token_scan.h"
+#include <algorithm>
+#include <clocale>
+#include <cstdio>
+#include <cwctype>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace exole;
+
+static const wchar_t *skip_space(const wchar_t *p, const wchar_t *end)
+{
+    while (p < end && iswspace(*p))
+        p++;
+    return p;
+}
+
+/// The state machine alone, one character at a time.
+static void parse_by_push(const wchar_t *line, size_t len, const wchar_t *cursor,
+        std::vector<Token> &tokens, CursorInfo &info)
+{
+    tokens.clear();
+    const wchar_t *end = line + len;
+    const wchar_t *p = skip_space(line, end);
+    while (p < end) {
+        Token token;
+        TokenState ts;
+        do {
+            ts = token.push(p, p == cursor);
+            p++;
+        } while (ts != TS_COMPLETE && p < end);
+        tokens.push_back(token);
+        p = skip_space(p, end);
+    }
+    if (cursor == end && !tokens.empty()) {
+        tokens.back().check_cursor(cursor);
+    }
+
+    info = CursorInfo();
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].cursor() >= 0) {
+            info.token_index = i;
+            info.prefix.assign(tokens[i].value_data(), tokens[i].cursor());
+            return;
+        }
+    }
+    if (!tokens.empty() && cursor >= tokens[0].original_begin()) {
+        info.token_index = tokens.size();
+    }
+}
+
+/// TokenParser asserts that a cursor outside the tokens is before the first one or after the end of the last one,
+/// so a cursor in the spaces between tokens, other than the one ending a token, is moved to the end of the line.
+static const wchar_t *valid_cursor(const wchar_t *line, size_t len, const wchar_t *cursor)
+{
+    std::vector<Token> tokens;
+    CursorInfo info;
+    parse_by_push(line, len, cursor, tokens, info);
+    if (cursor && info.token_index == tokens.size() && !tokens.empty() && cursor <= tokens.back().original_end()) {
+        return line + len;
+    }
+    return cursor;
+}
+
+static bool same_token(const Token &a, const Token &b)
+{
+    return a.original_begin() == b.original_begin() && a.original_end() == b.original_end()
+        && a.state() == b.state() && a.cursor() == b.cursor() && a.is_escaped() == b.is_escaped()
+        && std::wstring(a.value_data(), a.value_size()) == std::wstring(b.value_data(), b.value_size())
+        && a.value() == b.value();
+}
+
+static std::wstring random_line(std::mt19937 &rng)
+{
+    static const wchar_t alphabet[] = L"ab \t\n\"'\\xyz09-_/.~\x7f\x1f\u00e9\u2003\u3000";
+    static const size_t alphabet_size = sizeof(alphabet) / sizeof(alphabet[0]) - 1;
+    size_t len = rng() % 80;
+    bool plain = rng() % 3 == 0; // mostly long runs of letters
+    std::wstring line;
+    for (size_t i = 0; i < len; i++) {
+        if (plain && rng() % 8 != 0)
+            line.push_back(L'a' + rng() % 26);
+        else
+            line.push_back(alphabet[rng() % alphabet_size]);
+    }
+    return line;
+}
+
+/// Compare \a parser with tokenizing [line, line + len) by Token::push().
+static bool check_parser(const TokenParser &parser, const wchar_t *line, size_t len, const wchar_t *cursor)
+{
+    std::vector<Token> expected;
+    CursorInfo expected_info;
+    parse_by_push(line, len, cursor, expected, expected_info);
+    const std::vector<Token> &tokens = parser.tokens();
+    bool ok = tokens.size() == expected.size()
+        && parser.get_cursor_info().token_index == expected_info.token_index
+        && parser.get_cursor_info().prefix == expected_info.prefix;
+    for (size_t k = 0; ok && k < tokens.size(); k++) {
+        ok = same_token(tokens[k], expected[k]);
+    }
+    return ok;
+}
+
+/// Print a mismatch, with characters other than printable ASCII escaped, so that it is readable in any locale.
+/// \return \a failed plus 1
+static long report(const char *name, long failed, const std::wstring &line, const wchar_t *cursor)
+{
+    if (failed < 5) {
+        printf("%s: mismatch in [", name);
+        for (wchar_t c : line) {
+            if (c >= 0x20 && c < 0x7f)
+                putchar(c);
+            else
+                printf("\\x{%x}", unsigned(c));
+        }
+        printf("] at cursor %ld\n", cursor ? long(cursor - line.c_str()) : -1L);
+    }
+    return failed + 1;
+}
+
+/// \return the number of mismatches
+static long test_parse(const char *name, int iterations)
+{
+    std::mt19937 rng(1);
+    long failed = 0;
+    for (int i = 0; i < iterations; i++) {
+        std::wstring line = random_line(rng);
+        const wchar_t *cursor = line.c_str() + rng() % (line.size() + 1);
+        if (rng() % 16 == 0)
+            cursor = nullptr;
+        cursor = valid_cursor(line.c_str(), line.size(), cursor);
+
+        TokenParser parser;
+        parser.parse(line.c_str(), line.size(), cursor);
+        if (!check_parser(parser, line.c_str(), line.size(), cursor))
+            failed = report(name, failed, line, cursor);
+    }
+    return failed;
+}
+
+/// Edit a line like typing and completing, e.g. insert or delete characters, mostly near the cursor.
+/// \return the new cursor position.
+static size_t edit_line(std::mt19937 &rng, std::wstring &line, size_t cursor)
+{
+    static const wchar_t alphabet[] = L"ab \t\"'\\xyz-\u00e9\u3000";
+    static const size_t alphabet_size = sizeof(alphabet) / sizeof(alphabet[0]) - 1;
+    size_t pos = (rng() % 4 == 0) ? rng() % (line.size() + 1) : cursor;
+    switch (rng() % 5) {
+    case 0: // a new line
+        line = random_line(rng);
+        return rng() % (line.size() + 1);
+    case 1: // delete
+        if (pos > 0) {
+            size_t n = std::min<size_t>(pos, 1 + rng() % 4);
+            line.erase(pos - n, n);
+            return pos - n;
+        }
+        return pos;
+    case 2: // move the cursor
+        return rng() % (line.size() + 1);
+    default: // insert, e.g. typing or a completion
+        {
+            size_t n = 1 + rng() % 6;
+            for (size_t i = 0; i < n; i++) {
+                wchar_t c = rng() % 2 ? alphabet[rng() % alphabet_size] : L'a' + rng() % 26;
+                line.insert(line.begin() + pos + i, c);
+            }
+            return pos + n;
+        }
+    }
+}
+
+/// reparse() after random edits must give the same tokens as parsing the line afresh.
+/// \return the number of mismatches
+static long test_reparse(const char *name, int iterations)
+{
+    std::mt19937 rng(3);
+    long failed = 0;
+    TokenParser parser;
+    std::wstring line;
+    size_t pos = 0;
+    for (int i = 0; i < iterations; i++) {
+        if (i % 100 == 0) {
+            parser = TokenParser(); // also start without a last line
+        }
+        pos = edit_line(rng, line, pos);
+        // a copy in a new buffer, so that the kept tokens must be moved to it
+        std::wstring text(line.begin(), line.end());
+        const wchar_t *cursor = valid_cursor(text.c_str(), text.size(), text.c_str() + pos);
+        parser.reparse(text.c_str(), text.size(), cursor);
+        if (!check_parser(parser, text.c_str(), text.size(), cursor))
+            failed = report(name, failed, text, cursor);
+    }
+    return failed;
+}
+
+/// A parser parsing a tail of the line of the shared parser starting between tokens, e.g. the arguments of
+/// a sub-command, takes its tokens, which must be the same as tokenizing the tail.
+/// \return the number of mismatches
+static long test_shared(const char *name, int iterations)
+{
+    std::mt19937 rng(4);
+    long failed = 0;
+    for (int i = 0; i < iterations; i++) {
+        std::wstring line = random_line(rng);
+        const wchar_t *cursor = line.c_str() + rng() % (line.size() + 1);
+        if (rng() % 16 == 0)
+            cursor = nullptr;
+        cursor = valid_cursor(line.c_str(), line.size(), cursor);
+
+        TokenParser shared;
+        shared.parse(line.c_str(), line.size(), cursor);
+        const TokenParser *old = TokenParser::set_shared(&shared);
+        for (size_t start = 0; start <= line.size(); start++) {
+            const wchar_t *tail = line.c_str() + start;
+            size_t len = line.size() - start;
+            if (valid_cursor(tail, len, cursor) != cursor) // a tail starting in quotes is tokenized differently
+                continue;
+            TokenParser parser;
+            parser.parse(tail, len, cursor);
+            if (!check_parser(parser, tail, len, cursor)) {
+                failed = report(name, failed, line, cursor);
+                break;
+            }
+        }
+        TokenParser::set_shared(old);
+    }
+    return failed;
+}
+
+static bool scalar_stops(detail::ScanMode mode, wchar_t c)
+{
+    switch (mode) {
+    case detail::SM_NORMAL:
+        return c <= 0x20 || c >= 0x7f || c == L'"' || c == L'\'' || c == L'\\';
+    case detail::SM_DQUOTE:
+        return c == L'"' || c == L'\\';
+    case detail::SM_SQUOTE:
+        return c == L'\'';
+    }
+    return true;
+}
+
+/// \return the number of mismatches
+static long test_scan(const char *name, int iterations)
+{
+    static const wchar_t stoppers[] = { L' ', L'\t', L'"', L'\'', L'\\', 0x7f, 0x80, 0x20, 0x21, 0x7e, 0,
+        wchar_t(-1), wchar_t(0x80000000), 0x3000 };
+    std::mt19937 rng(2);
+    long failed = 0;
+    for (int i = 0; i < iterations; i++) {
+        // runs of various lengths from various alignments, to cover the vector loops and their tails
+        std::vector<wchar_t> text(rng() % 40 + 1);
+        for (auto &c : text) {
+            c = rng() % 6 == 0 ? stoppers[rng() % (sizeof(stoppers) / sizeof(stoppers[0]))] : L'a' + rng() % 26;
+        }
+        const wchar_t *begin = text.data() + rng() % text.size();
+        const wchar_t *end = text.data() + text.size();
+        for (detail::ScanMode mode : { detail::SM_NORMAL, detail::SM_DQUOTE, detail::SM_SQUOTE }) {
+            const wchar_t *expected = begin;
+            while (expected < end && !scalar_stops(mode, *expected))
+                expected++;
+            if (detail::scan_token_run(begin, end, mode) != expected && failed++ < 5) {
+                printf("%s: scan mismatch in mode %d at offset %ld\n", name, mode, long(expected - text.data()));
+            }
+        }
+    }
+    return failed;
+}
+
+int main()
+{
+    setlocale(LC_ALL, "");
+    const struct {
+        detail::ScanImpl impl;
+        const char *name;
+    } impls[] = {
+        { detail::SI_SCALAR, "scalar" },
+        { detail::SI_SSE2, "sse2" },
+        { detail::SI_AVX2, "avx2" },
+    };
+    long failed = 0;
+    for (const auto &i : impls) {
+        if (!detail::set_scan_impl(i.impl)) {
+            printf("%s: not supported, skipped\n", i.name);
+            continue;
+        }
+        long n = test_scan(i.name, 100000) + test_parse(i.name, 100000);
+        printf("%s: %s\n", i.name, n ? "FAILED" : "ok");
+        failed += n;
+    }
+
+    long n = test_reparse("reparse", 100000);
+    printf("reparse: %s\n", n ? "FAILED" : "ok");
+    failed += n;
+    n = test_shared("shared", 5000);
+    printf("shared: %s\n", n ? "FAILED" : "ok");
+    failed += n;
+    return failed ? 1 : 0;
+}
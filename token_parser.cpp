@@ -1,4 +1,6 @@
 #include "token_parser.h"
+#include "detail/token_scan.h"
+#include <algorithm>
 #include <cassert>
 #include <cwctype>
 
@@ -9,17 +11,34 @@ Token::Token()
     , end_(nullptr)
     , cursor_(-1)
     , state_(TS_NORMAL)
+    , escaped_(false)
 {
 }
 
-TokenState Token::push(const wchar_t *pc, bool is_cursor)
+void Token::escape(const wchar_t *pc)
 {
-    if (is_cursor) {
-        cursor_ = value_.size();
+    if (!escaped_) {
+        value_.assign(begin_, pc);
+        escaped_ = true;
+    }
+}
+
+const std::wstring &Token::value() const
+{
+    if (!escaped_ && value_.size() != original_size()) {
+        value_.assign(begin_, end_);
     }
+    return value_;
+}
+
+TokenState Token::push(const wchar_t *pc, bool is_cursor)
+{
     if (!begin_) {
         begin_ = pc;
     }
+    if (is_cursor) {
+        cursor_ = escaped_ ? value_.size() : pc - begin_;
+    }
     /* state chart:
     NORMAL: SPACE->COMPLETE, '->SQUOTE, "->DQUOTE, \->ESCAPE, OTHER->NORMAL
     DQUOTE: "->NORMAL, \->QESCAPE, OTHER->DQUOTE
@@ -41,16 +60,21 @@ TokenState Token::push(const wchar_t *pc, bool is_cursor)
         }
         switch (c) {
         case L'\\':
+            escape(pc);
             state_ = TS_ESCAPE;
             break;
         case L'"':
+            escape(pc);
             state_ = TS_DQUOTE;
             break;
         case L'\'':
+            escape(pc);
             state_ = TS_SQUOTE;
             break;
         default:
-            value_.push_back(c);
+            if (escaped_) {
+                value_.push_back(c);
+            }
             break;
         }
         break;
@@ -94,10 +118,38 @@ TokenState Token::push(const wchar_t *pc, bool is_cursor)
     return state_;
 }
 
+const wchar_t *Token::push_run(const wchar_t *p, const wchar_t *end)
+{
+    const wchar_t *q;
+    switch (state_) {
+    case TS_NORMAL:
+        q = detail::scan_token_run(p, end, detail::SM_NORMAL);
+        break;
+    case TS_DQUOTE:
+        q = detail::scan_token_run(p, end, detail::SM_DQUOTE);
+        break;
+    case TS_SQUOTE:
+        q = detail::scan_token_run(p, end, detail::SM_SQUOTE);
+        break;
+    default:
+        return p;
+    }
+    if (q != p) {
+        if (!begin_) {
+            begin_ = p;
+        }
+        if (escaped_) {
+            value_.append(p, q);
+        }
+        end_ = q;
+    }
+    return q;
+}
+
 void Token::check_cursor(const wchar_t *cursor)
 {
     if (cursor == end_) {
-        cursor_ = value_.size();
+        cursor_ = value_size();
     }
 }
 
@@ -108,18 +160,108 @@ static const wchar_t *skip_space(const wchar_t *p, const wchar_t *end)
     return p;
 }
 
+static thread_local const TokenParser *shared_parser = nullptr;
+
+TokenParser::TokenParser()
+    : line_(nullptr)
+    , line_end_(nullptr)
+    , cursor_(nullptr)
+    , has_text_(false)
+{
+}
+
 void TokenParser::parse(const wchar_t *line, size_t len, const wchar_t *cursor)
 {
+    if (take_shared(line, len, cursor)) {
+        return;
+    }
     tokens_.clear();
+    has_text_ = false;
+    tokenize(line, line, len, cursor);
+}
+
+void TokenParser::reparse(const wchar_t *line, size_t len, const wchar_t *cursor)
+{
+    if (take_shared(line, len, cursor)) {
+        return;
+    }
+    size_t keep = 0;
+    if (has_text_) {
+        // a token is kept if the whitespace which ends it is before both the first changed character and the cursor
+        size_t n = std::min(len, text_.size());
+        size_t same = std::mismatch(line, line + n, text_.data()).first - line;
+        if (cursor >= line && cursor <= line + len) {
+            same = std::min(same, size_t(cursor - line));
+        }
+        while (keep < tokens_.size() && size_t(tokens_[keep].end_ - line_) < same) {
+            Token &token = tokens_[keep];
+            token.begin_ = line + (token.begin_ - line_);
+            token.end_ = line + (token.end_ - line_);
+            token.cursor_ = -1;
+            keep++;
+        }
+    }
+    tokens_.resize(keep);
+    text_.assign(line, len);
+    has_text_ = true;
+    tokenize(line, keep > 0 ? tokens_.back().end_ : line, len, cursor);
+}
+
+const TokenParser *TokenParser::shared()
+{
+    return shared_parser;
+}
+
+const TokenParser *TokenParser::set_shared(const TokenParser *parser)
+{
+    const TokenParser *old = shared_parser;
+    shared_parser = parser;
+    return old;
+}
+
+bool TokenParser::take_shared(const wchar_t *line, size_t len, const wchar_t *cursor)
+{
+    const TokenParser *shared = shared_parser;
+    if (shared == nullptr || cursor != shared->cursor_ || line + len != shared->line_end_
+            || line < shared->line_ || line > shared->line_end_) {
+        return false;
+    }
+    if (shared == this) { // e.g. parsed by the console completing with it
+        return line == line_;
+    }
+    // the line must start between tokens, then it has the tokens of the shared line after it
+    const std::vector<Token> &tokens = shared->tokens_;
+    size_t first = 0;
+    while (first < tokens.size() && tokens[first].begin_ < line)
+        first++;
+    if (first > 0 && tokens[first - 1].end_ > line) {
+        return false;
+    }
+    tokens_.assign(tokens.begin() + first, tokens.end());
+    line_ = line;
+    line_end_ = line + len;
+    cursor_ = cursor;
+    has_text_ = false;
+    update_cursor_info(cursor);
+    return true;
+}
+
+void TokenParser::tokenize(const wchar_t *line, const wchar_t *p, size_t len, const wchar_t *cursor)
+{
     const wchar_t *end = line + len;
-    const wchar_t *p = skip_space(line, end);
+    p = skip_space(p, end);
     while (p < end) {
         Token token;
-        TokenState ts;
-        do {
-            ts = token.push(p, p == cursor);
+        for (;;) {
+            // the character at the cursor goes through push(), which records the cursor
+            p = token.push_run(p, cursor >= p && cursor < end ? cursor : end);
+            if (p == end)
+                break;
+            TokenState ts = token.push(p, p == cursor);
             p++;
-        } while (ts != TS_COMPLETE && p < end);
+            if (ts == TS_COMPLETE || p == end)
+                break;
+        }
         assert(token.original_size() > 0);
         tokens_.push_back(token);
         p = skip_space(p, end);
@@ -131,7 +273,14 @@ void TokenParser::parse(const wchar_t *line, size_t len, const wchar_t *cursor)
         }
     }
 
-    // update cursor info
+    line_ = line;
+    line_end_ = end;
+    cursor_ = cursor;
+    update_cursor_info(cursor);
+}
+
+void TokenParser::update_cursor_info(const wchar_t *cursor)
+{
     int cursor_index = find_token_at_cursor();
     if (cursor_index == -1) {
         cursor_info_.prefix.clear();
@@ -149,7 +298,7 @@ void TokenParser::parse(const wchar_t *line, size_t len, const wchar_t *cursor)
     else {
         const Token &t = tokens_[cursor_index];
         cursor_info_.token_index = cursor_index;
-        cursor_info_.prefix = t.value().substr(0, t.cursor());
+        cursor_info_.prefix.assign(t.value_data(), t.cursor());
     }
 }
 
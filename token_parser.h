@@ -19,21 +19,38 @@ enum TokenState
 struct Token
 {
 private:
+    friend class TokenParser;
+
     // pointer to original text
     const wchar_t *begin_;
     const wchar_t *end_;
 
-    // escaped text e.g. "a""\\b" -> a\b
-    std::wstring value_;
+    // escaped text e.g. "a""\\b" -> a\b. Only made if the token has quotes or backslashes, or value() is called;
+    // otherwise the value is the original text.
+    mutable std::wstring value_;
 
-    int cursor_; // default -1. Use cursor with value_ rather than begin_.
+    int cursor_; // default -1. Use cursor with value_data() rather than begin_.
     TokenState state_;
+    bool escaped_; // value_ differs from the original text
+
+    /// Start an owned value with the original text so far, when the first quote or backslash comes.
+    void escape(const wchar_t *pc);
 
 public:
     Token();
     TokenState push(const wchar_t *pc, bool is_cursor);
+    /// Push the characters in [p, end) which push() would simply append to the value, at once.
+    /// \return the first character not pushed.
+    const wchar_t *push_run(const wchar_t *p, const wchar_t *end);
     size_t original_size() const { return end_ - begin_; }
-    const std::wstring &value() const { return value_; }
+    /// The unescaped value, which points into the original text unless is_escaped().
+    /// It is not null-terminated.
+    const wchar_t *value_data() const { return escaped_ ? value_.data() : begin_; }
+    size_t value_size() const { return escaped_ ? value_.size() : end_ - begin_; }
+    bool is_escaped() const { return escaped_; }
+    /// The unescaped value as a string, which is copied from the original text on the first call unless
+    /// is_escaped(). Prefer value_data() and value_size().
+    const std::wstring &value() const;
     const wchar_t *original_begin() const { return begin_; }
     const wchar_t *original_end() const { return end_; }
     TokenState state() const { return state_; }
@@ -55,16 +72,42 @@ struct CursorInfo
 class TokenParser
 {
 public:
+    TokenParser();
+
+    /// Tokenize a line. If \a line is a tail of the line of the shared parser (see set_shared()) starting between
+    /// tokens, e.g. the arguments of a sub-command, and the cursor is the same, the tokens are taken from it.
     void parse(const wchar_t *line, size_t len, const wchar_t *cursor);
+    /// Like parse(), but keep the tokens of the last reparse() which end before both the first changed character
+    /// and the cursor, and tokenize only the rest, e.g. when the same line is completed again after typing.
+    void reparse(const wchar_t *line, size_t len, const wchar_t *cursor);
 
     const std::vector<Token> &tokens() const { return tokens_; }
     const CursorInfo &get_cursor_info() const { return cursor_info_; }
+
+    /// The parser shared by the calling thread, nullptr if there is none.
+    static const TokenParser *shared();
+    /// Share \a parser with the calling thread, so that parse() of a tail of its line need not tokenize again,
+    /// nullptr to stop sharing. The parser must outlive the sharing and stay unchanged.
+    /// \return the previous one.
+    static const TokenParser *set_shared(const TokenParser *parser);
 private:
+    /// Take the tokens of the shared parser, see parse().
+    /// \return false if they cannot be taken.
+    bool take_shared(const wchar_t *line, size_t len, const wchar_t *cursor);
+    /// Tokenize [p, line + len) after the tokens there are, and update the cursor info.
+    void tokenize(const wchar_t *line, const wchar_t *p, size_t len, const wchar_t *cursor);
+    void update_cursor_info(const wchar_t *cursor);
     /// @return -1 if not found
     int find_token_at_cursor() const;
 
     std::vector<Token> tokens_;
     CursorInfo cursor_info_;
+    // the last line parsed
+    const wchar_t *line_;
+    const wchar_t *line_end_;
+    const wchar_t *cursor_;
+    std::wstring text_; // copy of the last line given to reparse(), to find the changed characters
+    bool has_text_;
 };
 
 } // namespace exole
@@ -27,7 +27,11 @@ ScopedGuard<T, Release> MakeScopeGuard(T resource, Release release)
     
 } // exole
 
+// Concatenate after expanding the arguments, e.g. EXOLE_CONCAT(x_, __LINE__) -> x_42
+#define EXOLE_CONCAT_IMPL(A, B) A##B
+#define EXOLE_CONCAT(A, B) EXOLE_CONCAT_IMPL(A, B)
+
 #define EXOLE_SCOPE_EXIT(RES, ON_EXIT)\
-    auto _SCOPE_EXIT_##__LINE__ = ::exole::MakeScopeGuard(RES, ON_EXIT)
+    auto EXOLE_CONCAT(exole_scope_exit_, __LINE__) = ::exole::MakeScopeGuard(RES, ON_EXIT)
 
 #endif // EXOLE_UTIL_H
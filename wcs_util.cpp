@@ -32,11 +32,10 @@ std::string wcs_to_mbs(const wchar_t *wstr)
 
 std::wstring mbs_to_wcs(const char *mbstr, int len)
 {
-    int dstlen = len;
-    wchar_t *dst = new wchar_t [dstlen];
-    size_t n = ::mbsnrtowcs(dst, &mbstr, len, dstlen, nullptr);
-    std::wstring str(dst, n);
-    delete [] dst;
+    // convert into the result directly, a multibyte string never has fewer bytes than characters
+    std::wstring str(len, L'\0');
+    size_t n = ::mbsnrtowcs(&str[0], &mbstr, len, len, nullptr);
+    str.resize(n == size_t(-1) ? 0 : n);
     return str;
 }
 